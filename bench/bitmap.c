@@ -0,0 +1,118 @@
+/***********************************************************************************************************************
+ *
+ * ID100 Utility
+ * Bitmap and Character Benchmark
+ *
+ * (C) 2017 Gergely Budai
+ *
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ *
+ **********************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "bench.h"
+#include "app.h"
+#include "bitmap.h"
+#include "char.h"
+
+// Frames in the ASCII picture stream
+#define BENCH_FRAMES 1000
+
+/***********************************************************************************************************************
+ * Measure ASCII picture printing and parsing and text rendering
+ **********************************************************************************************************************/
+int main(void)
+{
+  static AppMatrixBitmapType bitmaps[BENCH_FRAMES];
+  static char text[BENCH_FRAMES * (BITMAP_MAX_TEXT_LENGTH + BITMAP_ROWS + 1)];
+  AppMatrixBitmapType bitmap;
+  uint64_t frames = 0;
+  size_t textLength;
+  uint32_t i;
+  uint8_t row, column;
+  double start, elapsed;
+  FILE *file;
+
+  // Random pictures, set dot by dot as the bitmap has unused bits
+  srand(1);
+  for(i = 0; i < BENCH_FRAMES; i++) {
+    for(row = 0; row < BITMAP_ROWS; row++) {
+      for(column = 0; column < BITMAP_COLS; column++) {
+        BitmapSetDot(bitmaps[i], (rand() & 1) ? BitmapDotSet : BitmapDotClear, row, column);
+      }
+    }
+  }
+
+  // Print all frames into memory
+  start = BenchNow();
+  do {
+    if((file = fmemopen(text, sizeof(text), "w")) == NULL) {
+      perror("Could not open memory stream");
+      return EXIT_FAILURE;
+    }
+    for(i = 0; i < BENCH_FRAMES; i++) {
+      BitmapPrint(file, bitmaps[i], '#');
+    }
+    textLength = ftell(file);
+    fclose(file);
+    frames += BENCH_FRAMES;
+  } while((elapsed = BenchNow() - start) < BENCH_MIN_SECONDS);
+  BenchReport("bitmap", "print", frames / elapsed, "frames/s");
+
+  // Parse them back
+  frames = 0;
+  start = BenchNow();
+  do {
+    if((file = fmemopen(text, textLength, "r")) == NULL) {
+      perror("Could not open memory stream");
+      return EXIT_FAILURE;
+    }
+    for(i = 0; BitmapRead(file, bitmap, '#', ':') == BITMAP_ROWS; i++) {
+      if(memcmp(bitmap, bitmaps[i], sizeof(bitmap)) != 0) {
+        fprintf(stderr, "Bitmap %u differs after parsing\n", i);
+        return EXIT_FAILURE;
+      }
+    }
+    fclose(file);
+    frames += i;
+  } while((elapsed = BenchNow() - start) < BENCH_MIN_SECONDS);
+  BenchReport("bitmap", "read", frames / elapsed, "frames/s");
+
+  // Render clock texts
+  frames = 0;
+  start = BenchNow();
+  do {
+    memset(bitmap, 0, sizeof(bitmap));
+    CharPutText(bitmap, "12:34", 0, 0);
+    CharPutText(bitmap, "56", 6, 5);
+    frames++;
+  } while((elapsed = BenchNow() - start) < BENCH_MIN_SECONDS);
+  BenchReport("char", "put_text", frames / elapsed, "frames/s");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,76 @@
+/***********************************************************************************************************************
+ *
+ * ID100 Utility
+ * CRC-16 Benchmark
+ *
+ * (C) 2017 Gergely Budai
+ *
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ *
+ **********************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "bench.h"
+#include "crc16.h"
+
+// Size of the buffer to checksum
+#define BENCH_BUFFER_SIZE (1024 * 1024)
+
+/***********************************************************************************************************************
+ * Measure the throughput of every CRC-16 implementation
+ **********************************************************************************************************************/
+int main(void)
+{
+  static uint8_t buffer[BENCH_BUFFER_SIZE];
+  Crc16VariantType variant;
+  uint32_t i;
+
+  if(Crc16SelfCheck()) {
+    fprintf(stderr, "CRC-16 self check failed\n");
+    return EXIT_FAILURE;
+  }
+
+  srand(1);
+  for(i = 0; i < sizeof(buffer); i++) {
+    buffer[i] = rand();
+  }
+
+  for(variant = 0; variant < Crc16NumberOfVariants; variant++) {
+    volatile Crc16Type crc = 0xFFFF;
+    uint64_t bytes = 0;
+    double start = BenchNow(), elapsed;
+
+    do {
+      crc = Crc16UpdateBufferVariant(variant, crc, buffer, sizeof(buffer));
+      bytes += sizeof(buffer);
+    } while((elapsed = BenchNow() - start) < BENCH_MIN_SECONDS);
+
+    BenchReport("crc16", Crc16VariantName(variant), bytes / elapsed, "B/s");
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+/***********************************************************************************************************************
+ *
+ * ID100 Utility
+ * End to End Device Benchmark
+ *
+ * (C) 2017 Gergely Budai
+ *
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ *
+ **********************************************************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "bench.h"
+#include "app.h"
+#include "clock_config.h"
+#include "display.h"
+
+// Simulator to run against, at full speed without line and flash timing
+#define BENCH_SIMULATOR "./id100sim"
+// Whole day, as the command line does by default
+#define BENCH_TIME_RANGE "00:00:00-23:59:59"
+// Frames shown on the display
+#define BENCH_DISPLAY_FRAMES 2000
+
+/***********************************************************************************************************************
+ * Start the simulator, return its process and the pseudo terminal in device
+ **********************************************************************************************************************/
+static pid_t BenchStartSimulator(char *device, size_t size)
+{
+  char *simulator = getenv("ID100SIM") ? getenv("ID100SIM") : BENCH_SIMULATOR;
+  int pipeFd[2], nullFd;
+  FILE *output;
+  pid_t pid;
+
+  if((pipe(pipeFd) != 0) || ((pid = fork()) < 0)) {
+    perror("Could not start simulator");
+    exit(EXIT_FAILURE);
+  }
+
+  if(pid == 0) {
+    // Statistics of the simulator are not interesting here
+    nullFd = open("/dev/null", O_WRONLY);
+    dup2(pipeFd[1], STDOUT_FILENO);
+    dup2(nullFd, STDERR_FILENO);
+    close(pipeFd[0]);
+    execl(simulator, simulator, "-b", "0", "-e", "0", "-p", "0", NULL);
+    _exit(EXIT_FAILURE);
+  }
+
+  close(pipeFd[1]);
+  if(((output = fdopen(pipeFd[0], "r")) == NULL) || (fgets(device, size, output) == NULL)) {
+    fprintf(stderr, "Could not run simulator %s\n", simulator);
+    exit(EXIT_FAILURE);
+  }
+  device[strcspn(device, "\n")] = '\0';
+  fclose(output);
+
+  return pid;
+}
+
+/***********************************************************************************************************************
+ * Remove one entry of the temporary directory
+ **********************************************************************************************************************/
+static int BenchRemove(const char *path, const struct stat *status, int flag, struct FTW *ftw)
+{
+  return remove(path);
+}
+
+/***********************************************************************************************************************
+ * Write a file with random contents
+ **********************************************************************************************************************/
+static void BenchWriteRandom(char *filename, size_t size)
+{
+  FILE *file = fopen(filename, "wb");
+
+  if(file == NULL) {
+    perror("Could not create file");
+    exit(EXIT_FAILURE);
+  }
+  while(size--) {
+    fputc(rand(), file);
+  }
+  fclose(file);
+}
+
+/***********************************************************************************************************************
+ * Compare the contents of two files
+ **********************************************************************************************************************/
+static bool BenchFilesEqual(char *filename1, char *filename2)
+{
+  FILE *file1 = fopen(filename1, "rb"), *file2 = fopen(filename2, "rb");
+  bool equal = (file1 != NULL) && (file2 != NULL);
+  int c;
+
+  while(equal && ((c = fgetc(file1)) == fgetc(file2)) && (c != EOF));
+  equal = equal && (c == EOF);
+
+  if(file1 != NULL) {
+    fclose(file1);
+  }
+  if(file2 != NULL) {
+    fclose(file2);
+  }
+
+  return equal;
+}
+
+/***********************************************************************************************************************
+ * Measure complete clock configuration writes, reads and display streaming against the simulator
+ **********************************************************************************************************************/
+int main(void)
+{
+  char directory[] = "/tmp/id100bench.XXXXXX", device[64];
+  char imageFilename[64], readFilename[64], framesFilename[64];
+  double start;
+  pid_t simulator;
+  bool readBack;
+
+  // Keep mirror and journal of the simulated device away from the real ones
+  if(mkdtemp(directory) == NULL) {
+    perror("Could not create temporary directory");
+    return EXIT_FAILURE;
+  }
+  setenv("XDG_CACHE_HOME", directory, true);
+  snprintf(imageFilename, sizeof(imageFilename), "%s/image.bin", directory);
+  snprintf(readFilename, sizeof(readFilename), "%s/read.bin", directory);
+  snprintf(framesFilename, sizeof(framesFilename), "%s/frames.bin", directory);
+
+  srand(1);
+  BenchWriteRandom(imageFilename, APP_CLOCK_CONFIG_FLASH_PAGES * sizeof(AppClockMatrixBitmap));
+  BenchWriteRandom(framesFilename, BENCH_DISPLAY_FRAMES * sizeof(AppMatrixBitmapType));
+
+  simulator = BenchStartSimulator(device, sizeof(device));
+
+  start = BenchNow();
+  ClockConfigWrite(imageFilename, true, NULL, device, BENCH_TIME_RANGE, '#', ':', false, NULL, false, -1);
+  BenchReport("device", "write", APP_CLOCK_CONFIG_FLASH_PAGES / (BenchNow() - start), "pages/s");
+
+  start = BenchNow();
+  ClockConfigRead(readFilename, true, device, BENCH_TIME_RANGE, '#', ':', -1, false);
+  BenchReport("device", "read", APP_CLOCK_CONFIG_FLASH_PAGES / (BenchNow() - start), "pages/s");
+  readBack = BenchFilesEqual(readFilename, imageFilename);
+
+  start = BenchNow();
+  DisplayShowContent(framesFilename, true, device, '#', ':', 0, 1, false, false);
+  BenchReport("device", "display", BENCH_DISPLAY_FRAMES / (BenchNow() - start), "frames/s");
+
+  kill(simulator, SIGTERM);
+  waitpid(simulator, NULL, 0);
+  nftw(directory, BenchRemove, 16, FTW_DEPTH | FTW_PHYS);
+
+  // Throughput is worthless if the data did not make it
+  if(!readBack) {
+    fprintf(stderr, "Clock configuration read back differs from the one written\n");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
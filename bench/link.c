@@ -0,0 +1,102 @@
+/***********************************************************************************************************************
+ *
+ * ID100 Utility
+ * Link Layer Benchmark
+ *
+ * (C) 2017 Gergely Budai
+ *
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ *
+ **********************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "bench.h"
+#include "app.h"
+#include "link.h"
+
+// Chunk size when feeding the decoder like a slow serial line
+#define BENCH_CHUNK_SIZE 7
+
+/***********************************************************************************************************************
+ * Measure decoding of a frame fed in chunks of the given size, return payload bytes per second
+ **********************************************************************************************************************/
+static double BenchDecode(const uint8_t *frame, uint16_t frameLength, uint16_t chunkSize, uint16_t payloadLength)
+{
+  static uint8_t buffer[LINK_MAX_BUFFER_LENGTH];
+  LinkDecoderType decoder;
+  uint64_t bytes = 0;
+  double start = BenchNow(), elapsed;
+
+  do {
+    uint16_t offset = 0, consumed, chunk;
+    LinkDecoderEventType event = LinkDecoderMore;
+
+    LinkDecoderInit(&decoder, buffer, sizeof(buffer));
+    while(event == LinkDecoderMore) {
+      chunk = ((frameLength - offset) < chunkSize) ? (frameLength - offset) : chunkSize;
+      event = LinkDecoderPush(&decoder, &frame[offset], chunk, &consumed);
+      offset += consumed;
+    }
+    if(event != LinkDecoderFrame) {
+      fprintf(stderr, "Frame decoding failed\n");
+      exit(EXIT_FAILURE);
+    }
+    bytes += payloadLength;
+  } while((elapsed = BenchNow() - start) < BENCH_MIN_SECONDS);
+
+  return bytes / elapsed;
+}
+
+/***********************************************************************************************************************
+ * Measure frame encoding and decoding with a flash page answer, the biggest frame on the line
+ **********************************************************************************************************************/
+int main(void)
+{
+  static uint8_t frame[LINK_MAX_FRAME_LENGTH(sizeof(AppFlashConfigPageType))];
+  AppFlashConfigPageType page;
+  uint16_t frameLength = 0;
+  uint64_t bytes = 0;
+  uint32_t i;
+  double start, elapsed;
+
+  srand(1);
+  for(i = 0; i < sizeof(page); i++) {
+    ((uint8_t *)&page)[i] = rand();
+  }
+
+  start = BenchNow();
+  do {
+    frameLength = LinkEncodeFrame(frame, 'f', &page, sizeof(page));
+    bytes += sizeof(page);
+  } while((elapsed = BenchNow() - start) < BENCH_MIN_SECONDS);
+  BenchReport("link", "encode", bytes / elapsed, "B/s");
+
+  BenchReport("link", "decode", BenchDecode(frame, frameLength, frameLength, sizeof(page)), "B/s");
+  BenchReport("link", "decode_chunked", BenchDecode(frame, frameLength, BENCH_CHUNK_SIZE, sizeof(page)), "B/s");
+
+  return EXIT_SUCCESS;
+}
@@ -32,8 +32,12 @@
  *
  **********************************************************************************************************************/
 #include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
 #include "app.h"
-#include "utils.h"
 #include "link.h"
 
 // Macro to correct endianness (ID100 is Big Endian)
@@ -46,143 +50,335 @@
 // Limit PPM calibration value
 #define APP_PPM_LIMIT 189.0f
 
+// Time to wait for the line to go quiet before retransmitting a command (us)
+#define APP_RETRY_QUIET_TIME 100000
+
+// Retries for new connections
+static uint8_t appDefaultRetries = APP_DEFAULT_RETRIES;
+
+// Connection to one device
+struct AppStruct {
+  LinkType *link;
+  // Retry policy
+  uint8_t retries;
+  // Number of commands sent again after an error
+  uint32_t retransmits;
+  // Description of the last error
+  char error[LINK_MAX_ERROR_LENGTH + 32];
+  // Connected to a daemon, whose answers are received here first as they may carry an error instead
+  bool socket;
+  uint8_t answer[LINK_MAX_BUFFER_LENGTH];
+};
+
+/***********************************************************************************************************************
+ * Remember the description of an error and return its status
+ **********************************************************************************************************************/
+static AppStatusType AppError(AppType *app, AppStatusType status, const char *fmt, ...)
+{
+  va_list va;
+
+  va_start(va, fmt);
+  vsnprintf(app->error, sizeof(app->error), fmt, va);
+  va_end(va);
+
+  return status;
+}
+
 /***********************************************************************************************************************
- * Send command and data to link layer and receive answer from it
+ * Translate a link layer failure into an application status
  **********************************************************************************************************************/
-static void AppSendAndReceive(const uint8_t command, const void *sendBuf, const uint16_t sendBufLen,
-  void *recvBuf, const uint16_t recvBufLen)
+static AppStatusType AppLinkError(AppType *app, LinkStatusType status)
 {
+  static const AppStatusType statusMap[] = {
+    [LinkOk]       = AppOk,
+    [LinkTimeout]  = AppTimeout,
+    [LinkIoError]  = AppIoError,
+    [LinkBadFrame] = AppFrameError,
+    [LinkTooBig]   = AppFrameError,
+    [LinkCrcError] = AppFrameError
+  };
+
+  return AppError(app, statusMap[status], "%s", LinkGetError(app->link));
+}
+
+/***********************************************************************************************************************
+ * Send command and data to link layer and receive answer from it once
+ * With answerLength given the answer may be shorter than the receive buffer, its length is returned there.
+ **********************************************************************************************************************/
+static AppStatusType AppTransfer(AppType *app, const uint8_t command, const void *sendBuf, const uint16_t sendBufLen,
+  void *recvBuf, const uint16_t recvBufLen, const bool echoPage, uint16_t *answerLength)
+{
+  LinkStatusType status;
   uint8_t recvCmd;
   uint16_t recvLength;
 
   // Send command and optional data
-  LinkSendCommandAndBuffer(command, sendBuf, sendBufLen);
+  if((status = LinkSendCommandAndBuffer(app->link, command, sendBuf, sendBufLen)) != LinkOk) {
+    return AppLinkError(app, status);
+  }
 
   // Receive answer
-  recvLength = LinkReceiveCommandAndBuffer(&recvCmd, recvBuf, recvBufLen);
+  if((status = LinkReceiveCommandAndBuffer(app->link, &recvCmd, app->socket ? app->answer : recvBuf,
+     app->socket ? sizeof(app->answer) : recvBufLen, &recvLength)) != LinkOk) {
+    return AppLinkError(app, status);
+  }
+  if(app->socket) {
+    // The daemon tells why the device did not serve the request
+    if((recvCmd == APP_DAEMON_ERROR) && (recvLength > 0)) {
+      return AppError(app, (app->answer[0] <= AppBadAnswer) ? app->answer[0] : AppBadAnswer, "%.*s",
+        recvLength - 1, &app->answer[1]);
+    }
+    if(recvLength > recvBufLen) {
+      return AppError(app, AppBadAnswer, "Invalid length received: %u", recvLength);
+    }
+    memcpy(recvBuf, app->answer, recvLength);
+  }
   // Check the received command
   if(recvCmd != command) {
-    ExitWithError("Invalid answer command received: '%c'", recvCmd);
+    return AppError(app, AppBadAnswer, "Invalid answer command received: '%c'", recvCmd);
   }
   // Check received buffer length
-  if(recvLength != recvBufLen) {
-    ExitWithError("Invalid length received: %u", recvLength);
+  if(answerLength != NULL) {
+    *answerLength = recvLength;
+  }
+  else if(recvLength != recvBufLen) {
+    return AppError(app, AppBadAnswer, "Invalid length received: %u", recvLength);
+  }
+  // Flash commands answer with the page number they were sent with
+  if(echoPage && (memcmp(sendBuf, recvBuf, sizeof(uint16_t)) != 0)) {
+    return AppError(app, AppBadAnswer, "Bad page number received: %u",
+      ((uint16_t)((uint8_t *)recvBuf)[0] << 8) | ((uint8_t *)recvBuf)[1]);
+  }
+
+  return AppOk;
+}
+
+/***********************************************************************************************************************
+ * Send command and data to link layer and receive answer from it, retransmit on recoverable errors
+ * Activating the bootloader and factory reset are never sent again: with only the answer lost the device has already
+ * left the application or lost its settings.
+ **********************************************************************************************************************/
+static AppStatusType AppSendAndReceiveAny(AppType *app, const uint8_t command, const void *sendBuf,
+  const uint16_t sendBufLen, void *recvBuf, const uint16_t recvBufLen, const bool echoPage, uint16_t *answerLength)
+{
+  AppStatusType status;
+  LinkStatusType linkStatus;
+  uint8_t attempt, retries = ((command == '!') || (command == 'X')) ? 0 : app->retries;
+
+  for(attempt = 0; ; attempt++) {
+    status = AppTransfer(app, command, sendBuf, sendBufLen, recvBuf, recvBufLen, echoPage, answerLength);
+    // A broken device will not get better by asking again
+    if((status == AppOk) || (status == AppIoError)) {
+      return status;
+    }
+    if(attempt >= retries) {
+      break;
+    }
+
+    // Throw away the rest of the broken answer and try again
+    if((linkStatus = LinkResync(app->link, APP_RETRY_QUIET_TIME)) != LinkOk) {
+      return AppLinkError(app, linkStatus);
+    }
+    app->retransmits++;
+  }
+
+  if(retries) {
+    size_t length = strlen(app->error);
+    snprintf(app->error + length, sizeof(app->error) - length, " (command '%c', %u retries)", command, retries);
+  }
+
+  return status;
+}
+
+/***********************************************************************************************************************
+ * Send command and data and receive an answer of exactly the receive buffer length
+ **********************************************************************************************************************/
+static AppStatusType AppSendAndReceive(AppType *app, const uint8_t command, const void *sendBuf,
+  const uint16_t sendBufLen, void *recvBuf, const uint16_t recvBufLen, const bool echoPage)
+{
+  return AppSendAndReceiveAny(app, command, sendBuf, sendBufLen, recvBuf, recvBufLen, echoPage, NULL);
+}
+
+/***********************************************************************************************************************
+ * Pass any command through to the device, with retries, the length of the answer is returned in answerLength
+ **********************************************************************************************************************/
+AppStatusType AppRelay(AppType *app, const uint8_t command, const void *sendBuf, const uint16_t sendBufLen,
+  void *recvBuf, const uint16_t recvBufLen, uint16_t *answerLength)
+{
+  return AppSendAndReceiveAny(app, command, sendBuf, sendBufLen, recvBuf, recvBufLen, false, answerLength);
+}
+
+/***********************************************************************************************************************
+ * Set the number of retries for connections initialized later
+ **********************************************************************************************************************/
+void AppSetDefaultRetries(uint8_t retries)
+{
+  appDefaultRetries = retries;
+}
+
+/***********************************************************************************************************************
+ * Initialize the application and lower layers, return the connection to the device or NULL with errno set
+ **********************************************************************************************************************/
+AppType *AppInit(void *ctx)
+{
+  AppType *app;
+
+  if((app = malloc(sizeof(*app))) == NULL) {
+    return NULL;
+  }
+  if((app->link = LinkConnect(ctx)) == NULL) {
+    free(app);
+    return NULL;
   }
+  app->socket = LinkIsSocket(app->link);
+  AppSetRetries(app, appDefaultRetries);
+  app->retransmits = 0;
+  app->error[0] = '\0';
+
+  return app;
+}
+
+/***********************************************************************************************************************
+ * Clean up the application and lower layers, AppIoError with errno set if the device could not be released cleanly
+ **********************************************************************************************************************/
+AppStatusType AppCleanup(AppType *app)
+{
+  LinkStatusType status = LinkDisconnect(app->link);
+
+  free(app);
+  return (status == LinkOk) ? AppOk : AppIoError;
+}
+
+/***********************************************************************************************************************
+ * Get the number of bytes sent and received on the wire so far
+ **********************************************************************************************************************/
+void AppGetWireBytes(AppType *app, uint64_t *sent, uint64_t *received)
+{
+  LinkGetWireBytes(app->link, sent, received);
 }
 
 /***********************************************************************************************************************
- * Initialize the application and lower layers
+ * Set the number of retries after a recoverable error
+ * Connections through a daemon never retry: the daemon retries on the device itself, and a late answer to the first
+ * request would be taken as the answer to the one sent again on the same stream.
  **********************************************************************************************************************/
-void AppInit(void *ctx)
+void AppSetRetries(AppType *app, uint8_t retries)
 {
-  LinkConnect(ctx);
+  app->retries = app->socket ? 0 : retries;
 }
 
 /***********************************************************************************************************************
- * Clean up the application and lower layers
+ * Get the number of commands sent again after an error
  **********************************************************************************************************************/
-void AppCleanup(void)
+uint32_t AppGetRetransmits(AppType *app)
 {
-  LinkDisconnect();
+  return app->retransmits;
+}
+
+/***********************************************************************************************************************
+ * Get the description of the last error
+ **********************************************************************************************************************/
+const char *AppGetError(AppType *app)
+{
+  return app->error;
 }
 
 /***********************************************************************************************************************
  * Get the firmware version
  **********************************************************************************************************************/
-void AppGetVersion(AppVersionType *version)
+AppStatusType AppGetVersion(AppType *app, AppVersionType *version)
 {
-  AppSendAndReceive('v', NULL, 0, version, sizeof(*version));
+  AppStatusType status = AppSendAndReceive(app, 'v', NULL, 0, version, sizeof(*version), false);
   APP_SWAP_ENDIAN_16(version->major);
   APP_SWAP_ENDIAN_16(version->minor);
   APP_SWAP_ENDIAN_16(version->revision);
+  return status;
 }
 
 /***********************************************************************************************************************
  * Get the actual date and time
  **********************************************************************************************************************/
-void AppGetDateTime(AppDateTimeType *dateTime)
+AppStatusType AppGetDateTime(AppType *app, AppDateTimeType *dateTime)
 {
-  AppSendAndReceive('t', NULL, 0, dateTime, sizeof(*dateTime));
+  return AppSendAndReceive(app, 't', NULL, 0, dateTime, sizeof(*dateTime), false);
 }
 
 /***********************************************************************************************************************
  * Set the actual date and time
  **********************************************************************************************************************/
-void AppSetDateTime(const AppDateTimeType *dateTime)
+AppStatusType AppSetDateTime(AppType *app, const AppDateTimeType *dateTime)
 {
-  AppSendAndReceive('T', dateTime, sizeof(*dateTime), NULL, 0);
+  return AppSendAndReceive(app, 'T', dateTime, sizeof(*dateTime), NULL, 0, false);
 }
 
 /***********************************************************************************************************************
  * Set normal mode
  **********************************************************************************************************************/
-void AppSetNormalMode(void)
+AppStatusType AppSetNormalMode(AppType *app)
 {
-  AppSendAndReceive('A', NULL, 0, NULL, 0);
+  return AppSendAndReceive(app, 'A', NULL, 0, NULL, 0, false);
 }
 
 /***********************************************************************************************************************
  * Set preview mode
  **********************************************************************************************************************/
-void AppSetPreviewMode(void)
+AppStatusType AppSetPreviewMode(AppType *app)
 {
-  AppSendAndReceive('a', NULL, 0, NULL, 0);
+  return AppSendAndReceive(app, 'a', NULL, 0, NULL, 0, false);
 }
 
 /***********************************************************************************************************************
  * Factory Reset
  **********************************************************************************************************************/
-void AppFactoryReset(void)
+AppStatusType AppFactoryReset(AppType *app)
 {
-  AppSendAndReceive('X', NULL, 0, NULL, 0);
+  return AppSendAndReceive(app, 'X', NULL, 0, NULL, 0, false);
 }
 
 /***********************************************************************************************************************
  * Activate Bootloader
  **********************************************************************************************************************/
-void AppActivateBootloader(void)
+AppStatusType AppActivateBootloader(AppType *app)
 {
-  AppSendAndReceive('!', NULL, 0, NULL, 0);
+  return AppSendAndReceive(app, '!', NULL, 0, NULL, 0, false);
 }
 
 /***********************************************************************************************************************
  * Set preview picture matrix
  **********************************************************************************************************************/
-void AppSetPreviewMatrix(const AppMatrixBitmapType matrix)
+AppStatusType AppSetPreviewMatrix(AppType *app, const AppMatrixBitmapType matrix)
 {
-  AppSendAndReceive('D', matrix, sizeof(AppMatrixBitmapType), NULL, 0);
+  return AppSendAndReceive(app, 'D', matrix, sizeof(AppMatrixBitmapType), NULL, 0, false);
 }
 
 /***********************************************************************************************************************
  * Get the standard intensity
  **********************************************************************************************************************/
-AppIntensityType AppGetIntensity()
+AppStatusType AppGetIntensity(AppType *app, AppIntensityType *intensity)
 {
-  AppIntensityType intensity;
-  AppSendAndReceive('b', NULL, 0, &intensity, sizeof(intensity));
-  return intensity;
+  return AppSendAndReceive(app, 'b', NULL, 0, intensity, sizeof(*intensity), false);
 }
 
 /***********************************************************************************************************************
  * Set the standard intensity
  **********************************************************************************************************************/
-void AppSetIntensity(const AppIntensityType intensity)
+AppStatusType AppSetIntensity(AppType *app, const AppIntensityType intensity)
 {
-  AppSendAndReceive('B', &intensity, sizeof(intensity), NULL, 0);
+  return AppSendAndReceive(app, 'B', &intensity, sizeof(intensity), NULL, 0, false);
 }
 
 /***********************************************************************************************************************
  * Get last calibration data
  **********************************************************************************************************************/
-void AppGetLastCalibration(AppLastCalibrationType *lastCalibration)
+AppStatusType AppGetLastCalibration(AppType *app, AppLastCalibrationType *lastCalibration)
 {
-  AppSendAndReceive('c', NULL, 0, lastCalibration, sizeof(*lastCalibration));
+  return AppSendAndReceive(app, 'c', NULL, 0, lastCalibration, sizeof(*lastCalibration), false);
 }
 
 /***********************************************************************************************************************
  * Set RTC Calibration value
  **********************************************************************************************************************/
-void AppSetRtcCalibration(AppRtcCalibrationValueType ppmDifference)
+AppStatusType AppSetRtcCalibration(AppType *app, AppRtcCalibrationValueType ppmDifference)
 {
   // Limit the PPM value
   if(ppmDifference > APP_PPM_LIMIT) {
@@ -192,86 +388,77 @@ void AppSetRtcCalibration(AppRtcCalibrationValueType ppmDifference)
     ppmDifference = -APP_PPM_LIMIT;
   }
 
-  AppSendAndReceive('C', &ppmDifference, sizeof(ppmDifference), NULL, 0);
+  return AppSendAndReceive(app, 'C', &ppmDifference, sizeof(ppmDifference), NULL, 0, false);
 }
 
 /***********************************************************************************************************************
  * Get Standby times
  **********************************************************************************************************************/
-void AppGetStandby(AppStandbyType *standby)
+AppStatusType AppGetStandby(AppType *app, AppStandbyType *standby)
 {
-  AppSendAndReceive('s', NULL, 0, standby, sizeof(*standby));
+  return AppSendAndReceive(app, 's', NULL, 0, standby, sizeof(*standby), false);
 }
 
 /***********************************************************************************************************************
  * Set Standby times
  **********************************************************************************************************************/
-void AppSetStandby(const AppStandbyType *standby)
+AppStatusType AppSetStandby(AppType *app, const AppStandbyType *standby)
 {
-  AppSendAndReceive('S', standby, sizeof(*standby), NULL, 0);
+  return AppSendAndReceive(app, 'S', standby, sizeof(*standby), NULL, 0, false);
 }
 
 /***********************************************************************************************************************
  * Get Flash configuration page
  **********************************************************************************************************************/
-void AppGetFlashConfigPage(uint16_t pageNumber, AppFlashConfigPageType *config)
+AppStatusType AppGetFlashConfigPage(AppType *app, uint16_t pageNumber, AppFlashConfigPageType *config)
 {
+  AppStatusType status;
+
   APP_SWAP_ENDIAN_16(pageNumber);
-  AppSendAndReceive('f', &pageNumber, sizeof(pageNumber), config, sizeof(*config));
-  APP_SWAP_ENDIAN_16(pageNumber);
+  status = AppSendAndReceive(app, 'f', &pageNumber, sizeof(pageNumber), config, sizeof(*config), true);
   APP_SWAP_ENDIAN_16(config->pageNumber);
 
-  if(config->pageNumber != pageNumber) {
-    ExitWithError("Bad page number received: %u", config->pageNumber);
-  }
+  return status;
 }
 
 /***********************************************************************************************************************
  * Erase Flash configuration sector
  **********************************************************************************************************************/
-void AppEraseFlashConfigSector(uint16_t startPage)
+AppStatusType AppEraseFlashConfigSector(AppType *app, uint16_t startPage)
 {
   uint16_t pageErased;
 
   APP_SWAP_ENDIAN_16(startPage);
-  AppSendAndReceive('E', &startPage, sizeof(startPage), &pageErased, sizeof(pageErased));
-  APP_SWAP_ENDIAN_16(pageErased);
-  APP_SWAP_ENDIAN_16(startPage);
-
-  if(pageErased != startPage) {
-    ExitWithError("Bad page number received: %u", pageErased);
-  }
+  return AppSendAndReceive(app, 'E', &startPage, sizeof(startPage), &pageErased, sizeof(pageErased), true);
 }
 
 /***********************************************************************************************************************
  * Set Flash configuration
  **********************************************************************************************************************/
-void AppSetFlashClockConfig(AppFlashClockConfigType *config)
+AppStatusType AppSetFlashClockConfig(AppType *app, AppFlashClockConfigType *config)
 {
+  AppStatusType status;
   uint16_t pageNumber;
 
   APP_SWAP_ENDIAN_16(config->pageNumber);
-  AppSendAndReceive('F', config, sizeof(*config), &pageNumber, sizeof(pageNumber));
+  status = AppSendAndReceive(app, 'F', config, sizeof(*config), &pageNumber, sizeof(pageNumber), true);
   APP_SWAP_ENDIAN_16(config->pageNumber);
-  APP_SWAP_ENDIAN_16(pageNumber);
 
-  if(pageNumber != config->pageNumber) {
-    ExitWithError("Bad page number received: %u", pageNumber);
-  }
+  return status;
 }
 
 /***********************************************************************************************************************
  * Get appointments
  **********************************************************************************************************************/
-void AppGetAppointments(AppointmentsConfigType appointments)
+AppStatusType AppGetAppointments(AppType *app, AppointmentsConfigType appointments)
 {
-  AppSendAndReceive('r', NULL, 0, appointments, sizeof(AppointmentsConfigType));
+  return AppSendAndReceive(app, 'r', NULL, 0, appointments, sizeof(AppointmentsConfigType), false);
 }
 
 /***********************************************************************************************************************
  * Set appointments
  **********************************************************************************************************************/
-void AppSetAppointments(const AppointmentsConfigType appointments)
+AppStatusType AppSetAppointments(AppType *app, const AppointmentsConfigType appointments)
 {
-  AppSendAndReceive('R', appointments, sizeof(AppointmentsConfigType), NULL, 0);
+  return AppSendAndReceive(app, 'R', appointments, sizeof(AppointmentsConfigType), NULL, 0, false);
 }
@@ -50,8 +50,36 @@
 /***********************************************************************************************************************
  * Layer init and cleanup
  **********************************************************************************************************************/
-void AppInit(void *ctx);
-void AppCleanup(void);
+typedef struct AppStruct AppType;
+
+// Result of a command sent to the device
+typedef enum {
+  AppOk = 0,
+  // No (complete) answer arrived in time
+  AppTimeout,
+  // The device can not be accessed any more, not worth retrying
+  AppIoError,
+  // Answer frame is broken (start byte, length or CRC)
+  AppFrameError,
+  // Answer frame is intact but does not belong to the command
+  AppBadAnswer
+} AppStatusType;
+
+// Number of times a command is sent again after a recoverable error
+#define APP_DEFAULT_RETRIES 3
+
+// Answer of a daemon to a request the device could not serve: status byte followed by the error description
+#define APP_DAEMON_ERROR 0x15
+
+void AppSetDefaultRetries(uint8_t retries);
+AppType *AppInit(void *ctx);
+AppStatusType AppCleanup(AppType *app);
+void AppGetWireBytes(AppType *app, uint64_t *sent, uint64_t *received);
+void AppSetRetries(AppType *app, uint8_t retries);
+uint32_t AppGetRetransmits(AppType *app);
+const char *AppGetError(AppType *app);
+AppStatusType AppRelay(AppType *app, const uint8_t command, const void *sendBuf, const uint16_t sendBufLen,
+  void *recvBuf, const uint16_t recvBufLen, uint16_t *answerLength);
 
 /***********************************************************************************************************************
  * Firmware Version
@@ -62,7 +90,7 @@ typedef struct __packed {
   uint16_t revision;
 } AppVersionType;
 
-void AppGetVersion(AppVersionType *version);
+AppStatusType AppGetVersion(AppType *app, AppVersionType *version);
 
 /***********************************************************************************************************************
  * Date and time
@@ -93,22 +121,22 @@ typedef struct __packed {
   AppDaylightSavingType daylightSaving;
 } AppDateTimeType;
 
-void AppGetDateTime(AppDateTimeType *dateTime);
-void AppSetDateTime(const AppDateTimeType *dateTime);
+AppStatusType AppGetDateTime(AppType *app, AppDateTimeType *dateTime);
+AppStatusType AppSetDateTime(AppType *app, const AppDateTimeType *dateTime);
 
 /***********************************************************************************************************************
  * Operating modes
  **********************************************************************************************************************/
-void AppFactoryReset(void);
-void AppActivateBootloader(void);
-void AppSetNormalMode(void);
-void AppSetPreviewMode(void);
+AppStatusType AppFactoryReset(AppType *app);
+AppStatusType AppActivateBootloader(AppType *app);
+AppStatusType AppSetNormalMode(AppType *app);
+AppStatusType AppSetPreviewMode(AppType *app);
 
 /***********************************************************************************************************************
  * Display bitmap matrix
  **********************************************************************************************************************/
 typedef uint8_t AppMatrixBitmapType[26];
-void AppSetPreviewMatrix(const AppMatrixBitmapType matrix);
+AppStatusType AppSetPreviewMatrix(AppType *app, const AppMatrixBitmapType matrix);
 
 /***********************************************************************************************************************
  * Intensity
@@ -125,14 +153,14 @@ typedef enum __packed {
   AppIntensity9 = 0xFF,
 } AppIntensityType;
 
-AppIntensityType AppGetIntensity();
-void AppSetIntensity(const AppIntensityType intensity);
+AppStatusType AppGetIntensity(AppType *app, AppIntensityType *intensity);
+AppStatusType AppSetIntensity(AppType *app, const AppIntensityType intensity);
 
 /***********************************************************************************************************************
  * RTC Calibration
  **********************************************************************************************************************/
 typedef float AppRtcCalibrationValueType;
-void AppSetRtcCalibration(AppRtcCalibrationValueType ppmDifference);
+AppStatusType AppSetRtcCalibration(AppType *app, AppRtcCalibrationValueType ppmDifference);
 
 typedef struct __packed {
   uint8_t day;
@@ -149,7 +177,7 @@ typedef struct __packed {
   AppRtcCalibrationDateTime lastCalibrationDateTime;
 } AppLastCalibrationType;
 
-void AppGetLastCalibration(AppLastCalibrationType *lastCalibration);
+AppStatusType AppGetLastCalibration(AppType *app, AppLastCalibrationType *lastCalibration);
 
 /***********************************************************************************************************************
  * Standby
@@ -162,8 +190,8 @@ typedef struct __packed {
   AppActiveType active;
 } AppStandbyType;
 
-void AppGetStandby(AppStandbyType *standby);
-void AppSetStandby(const AppStandbyType *standby);
+AppStatusType AppGetStandby(AppType *app, AppStandbyType *standby);
+AppStatusType AppSetStandby(AppType *app, const AppStandbyType *standby);
 
 /***********************************************************************************************************************
  * Flash configuration
@@ -181,19 +209,19 @@ typedef struct __packed {
   uint8_t dummy[256 - sizeof(AppClockMatrixBitmap)];
 } AppFlashConfigPageType;
 
-void AppGetFlashConfigPage(uint16_t pageNumber, AppFlashConfigPageType *config);
+AppStatusType AppGetFlashConfigPage(AppType *app, uint16_t pageNumber, AppFlashConfigPageType *config);
 
 typedef struct __packed {
   uint16_t pageNumber;
   AppClockMatrixBitmap matrixBitmap;
 } AppFlashClockConfigType;
 
-void AppSetFlashClockConfig(AppFlashClockConfigType *config);
+AppStatusType AppSetFlashClockConfig(AppType *app, AppFlashClockConfigType *config);
 
 // Number of pages per sector (erase unit, 16 * 256 = 4k)
 #define APP_FLASH_PAGES_PER_SECTOR  16
 
-void AppEraseFlashConfigSector(uint16_t startPage);
+AppStatusType AppEraseFlashConfigSector(AppType *app, uint16_t startPage);
 
 /***********************************************************************************************************************
  * Appointments
@@ -215,7 +243,7 @@ typedef struct __packed {
 } AppAppointmentType;
 
 typedef AppAppointmentType AppointmentsConfigType[20];
-void AppGetAppointments(AppointmentsConfigType appointments);
-void AppSetAppointments(const AppointmentsConfigType appointments);
+AppStatusType AppGetAppointments(AppType *app, AppointmentsConfigType appointments);
+AppStatusType AppSetAppointments(AppType *app, const AppointmentsConfigType appointments);
 
 #endif // APP_H_
@@ -68,33 +68,43 @@ void BitmapSetDot(AppMatrixBitmapType bitmap, BitmapDotType dot, uint8_t row, ui
 }
 
 /***********************************************************************************************************************
- * Print a bitmap as ACII to stdout
+ * Format a bitmap as ASCII picture into text (at least BITMAP_MAX_TEXT_LENGTH long), return the length
  **********************************************************************************************************************/
-void BitmapPrint(FILE *file, AppMatrixBitmapType bitmap, char dotchar)
+size_t BitmapFormat(char *text, AppMatrixBitmapType bitmap, char dotchar)
 {
-  int row, column;
+  char *line = text;
+  int row, column, lastDot;
 
   // For each row,
   for(row = 0; row < BITMAP_ROWS; row++) {
-    char line[(BITMAP_COLS * 2)];
-    // Format line
+    // Format line, remember the last dot to leave out trailing spaces
+    lastDot = -1;
     for(column = 0; column < BITMAP_COLS; column++) {
-      line[column * 2] =
-          (BitmapGetDot(bitmap, row, column) == BitmapDotSet) ? dotchar : BITMAP_SPACE_CHAR;
-      line[(column * 2) + 1] = BITMAP_SPACE_CHAR;
-    }
-    // Remove trailing spaces
-    for(column = sizeof(line) - 1; column >= 0; column--) {
-      if(line[column] == BITMAP_SPACE_CHAR) {
-        line[column] = '\0';
+      if(BitmapGetDot(bitmap, row, column) == BitmapDotSet) {
+        line[column * 2] = dotchar;
+        lastDot = column;
       }
       else {
-        break;
+        line[column * 2] = BITMAP_SPACE_CHAR;
       }
+      line[(column * 2) + 1] = BITMAP_SPACE_CHAR;
     }
-    // Print line
-    fprintf(file, "%s\n", line);
+    // Terminate line after the last dot
+    line += (lastDot >= 0) ? ((lastDot * 2) + 1) : 0;
+    *line++ = '\n';
   }
+
+  return line - text;
+}
+
+/***********************************************************************************************************************
+ * Print a bitmap as ACII to stdout
+ **********************************************************************************************************************/
+void BitmapPrint(FILE *file, AppMatrixBitmapType bitmap, char dotchar)
+{
+  char text[BITMAP_MAX_TEXT_LENGTH];
+
+  fwrite(text, BitmapFormat(text, bitmap, dotchar), 1, file);
 }
 
 /***********************************************************************************************************************
@@ -36,11 +36,15 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stddef.h>
 #include "app.h"
 
 #define BITMAP_ROWS 12
 #define BITMAP_COLS 17
 
+// Maximum length of a bitmap as ASCII picture (every row with dot, space and newline)
+#define BITMAP_MAX_TEXT_LENGTH (BITMAP_ROWS * BITMAP_COLS * 2)
+
 typedef enum {
   BitmapDotClear,
   BitmapDotSet
@@ -49,6 +53,7 @@ typedef enum {
 BitmapDotType BitmapGetDot(AppMatrixBitmapType bitmap, uint8_t row, uint8_t column);
 void BitmapSetDot(AppMatrixBitmapType bitmap, BitmapDotType dot, uint8_t row, uint8_t column);
 
+size_t BitmapFormat(char *text, AppMatrixBitmapType bitmap, char dotchar);
 void BitmapPrint(FILE *file, AppMatrixBitmapType bitmap, char dotchar);
 uint8_t BitmapRead(FILE *file, AppMatrixBitmapType bitmap, char dotchar, char commentchar);
 
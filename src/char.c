@@ -116,8 +116,8 @@ void CharOverlayText(char *filename, bool binary, char *device, char *overlay, c
   }
 
   // Show bitmap
-  AppInit(device);
-  AppSetPreviewMatrix(bitmap);
-  AppSetPreviewMode();
-  AppCleanup();
+  AppType *app = OpenDevice(device);
+  ExitOnAppError(app, AppSetPreviewMatrix(app, bitmap));
+  ExitOnAppError(app, AppSetPreviewMode(app));
+  CloseDevice(app);
 }
@@ -35,6 +35,7 @@
 #define CHAR_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "app.h"
 
 void CharPutChar(AppMatrixBitmapType bitmap, uint8_t ascii, uint8_t row, uint8_t column);
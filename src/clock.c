@@ -38,6 +38,7 @@
 #include "clock.h"
 #include "app.h"
 #include "file.h"
+#include "utils.h"
 
 /***********************************************************************************************************************
  * Get Clock
@@ -55,10 +56,10 @@ void ClockGet(char *filename, char *device)
   };
 
   // Get date and time
-  AppInit(device);
+  AppType *app = OpenDevice(device);
   AppDateTimeType dateTime;
-  AppGetDateTime(&dateTime);
-  AppCleanup();
+  ExitOnAppError(app, AppGetDateTime(app, &dateTime));
+  CloseDevice(app);
 
   // Print it
   FILE *file = FileOpen(filename, true);
@@ -76,7 +77,7 @@ void ClockSet(char *device)
 {
   time_t systime, oldtime;
 
-  AppInit(device);
+  AppType *app = OpenDevice(device);
 
   // Synchronize to second border
   oldtime = time(NULL);
@@ -97,7 +98,7 @@ void ClockSet(char *device)
   dateTime.daylightSaving = unixTime->tm_isdst;
 
   // Set it
-  AppSetDateTime(&dateTime);
+  ExitOnAppError(app, AppSetDateTime(app, &dateTime));
 
-  AppCleanup();
+  CloseDevice(app);
 }
@@ -35,16 +35,117 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "app.h"
 #include "utils.h"
 #include "file.h"
 #include "clock_config.h"
 #include "bitmap.h"
+#include "hash.h"
+#include "journal.h"
+#include "mirror.h"
+#include "parser.h"
+#include "parallel.h"
+#include "generator.h"
+#include "container.h"
+#include "progress.h"
+
+// Number of frames (one per second of the day) and lines in text format
+#define CLOCK_CONFIG_FRAMES (APP_CLOCK_CONFIG_FLASH_PAGES * APP_CLOCK_CONFIG_PER_PAGES)
+#define CLOCK_CONFIG_TEXT_LINES (CLOCK_CONFIG_FRAMES * BITMAP_ROWS)
+// Number of frames in a flash sector and number of sectors
+#define CLOCK_CONFIG_SECTOR_FRAMES (APP_FLASH_PAGES_PER_SECTOR * APP_CLOCK_CONFIG_PER_PAGES)
+#define CLOCK_CONFIG_SECTORS (APP_CLOCK_CONFIG_FLASH_PAGES / APP_FLASH_PAGES_PER_SECTOR)
+// Maximum length of the comment line in front of a frame in text format
+#define CLOCK_CONFIG_MAX_HEADER_LENGTH 24
+
+// Maximum length of a frame in text format
+#define CLOCK_CONFIG_MAX_FRAME_LENGTH (CLOCK_CONFIG_MAX_HEADER_LENGTH + BITMAP_MAX_TEXT_LENGTH)
+
+// Number of times a sector failing verification is rewritten
+#define CLOCK_CONFIG_VERIFY_RETRIES 3
+
+// Maximum number of devices written at once and number of times a failed device is retried
+#define CLOCK_CONFIG_MAX_DEVICES 64
+#define CLOCK_CONFIG_DEVICE_RETRIES 2
+// Maximum length of the description of a failure on a device
+#define CLOCK_CONFIG_MAX_ERROR_LENGTH 256
+// Time to let a device finish answering the interrupted command before retrying in microseconds
+#define CLOCK_CONFIG_RETRY_DELAY 200000
+
+// Frames formatted as text by the converter, each frame in its own slot
+typedef struct {
+  AppClockMatrixBitmap *image;
+  char *text;
+  uint16_t *lengths;
+  char dotchar;
+  char commentchar;
+} ClockConfigFormatterType;
+
+// How a sector has to be written
+typedef enum {
+  ClockConfigSectorUnchanged,
+  ClockConfigSectorProgram,
+  ClockConfigSectorEraseProgram
+} ClockConfigSectorPlanType;
+
+// Shared state of the input producer thread and the device writer
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  FILE *file;
+  bool binary;
+  char dotchar;
+  char commentchar;
+  GeneratorType *generator;
+  ClockConfigImageType *image;
+  // Number of pages loaded so far and hash over them, protected by lock
+  uint16_t pagesReady;
+  Hash64Type hash;
+} ClockConfigProducerType;
+
+// Image and settings shared by the writers of all devices
+typedef struct {
+  ClockConfigProducerType *producer;
+  ClockConfigImageType *base;
+  // Seconds to write and the sectors holding them, NULL if writing the whole day
+  const bool *selected;
+  const uint8_t *covered;
+  bool diff;
+  bool resume;
+  int32_t verifySamples;
+  // Number of times a failed device is written again
+  uint8_t retries;
+} ClockConfigJobType;
+
+// Connection to one device with its local state and the progress of the task running on it
+typedef struct {
+  char *path;
+  // Printed in front of the output when several devices are written at once, NULL otherwise
+  const char *label;
+  AppType *app;
+  MirrorType *mirror;
+  ProgressType *progress;
+  // Writing only, the image is a copy of its own if partly selected sectors get merged with the device contents
+  ClockConfigJobType *job;
+  ClockConfigImageType *image;
+  JournalType *journal;
+  bool journalTried;
+  pthread_t thread;
+  bool failed;
+  // Description of the last failure, system error details only make sense if the device itself failed
+  char error[CLOCK_CONFIG_MAX_ERROR_LENGTH];
+  bool ioError;
+} ClockConfigDeviceType;
 
 /***********************************************************************************************************************
- * Parse time string to absolute seconds
+ * Parse time range string to absolute seconds
  **********************************************************************************************************************/
-static void ClockConfigParseTime(char *timestamp, uint32_t *fromAbsSec, uint32_t *toAbsSec)
+static void ClockConfigParseRange(char *timestamp, uint32_t *fromAbsSec, uint32_t *toAbsSec)
 {
   unsigned int fromHour, fromMinute, fromSecond, toHour, toMinute, toSecond;
 
@@ -73,106 +174,1302 @@ static void ClockConfigParseTime(char *timestamp, uint32_t *fromAbsSec, uint32_t
   }
 }
 
+/***********************************************************************************************************************
+ * Parse comma separated list of time ranges into the set of selected seconds, return the number of seconds selected
+ * Ranges ending before they start wrap around midnight, overlapping ranges select their seconds only once.
+ **********************************************************************************************************************/
+static uint32_t ClockConfigParseTime(char *timestamp, bool selected[CLOCK_CONFIG_FRAMES])
+{
+  char ranges[strlen(timestamp) + 1], *range, *rest;
+  uint32_t from, to, count = 0;
+
+  memset(selected, false, CLOCK_CONFIG_FRAMES * sizeof(selected[0]));
+  strcpy(ranges, timestamp);
+  for(range = strtok_r(ranges, ",", &rest); range != NULL; range = strtok_r(NULL, ",", &rest)) {
+    ClockConfigParseRange(range, &from, &to);
+    // Mark seconds up to the end of range (or the day if wrapping)
+    for(;; from = (from + 1) % CLOCK_CONFIG_FRAMES) {
+      count += !selected[from];
+      selected[from] = true;
+      if(from == to) {
+        break;
+      }
+    }
+  }
+
+  if(count == 0) {
+    ExitWithError("Invalid timestamp: %s", timestamp);
+  }
+
+  return count;
+}
+
+/***********************************************************************************************************************
+ * Format the comment line in front of a frame in text format, return the length
+ **********************************************************************************************************************/
+static size_t ClockConfigFormatHeader(char *text, uint32_t secIdx, char commentchar)
+{
+  uint8_t hour   = secIdx / (60 * 60);
+  uint8_t minute = (secIdx / 60) % 60;
+  uint8_t second = secIdx % 60;
+  uint16_t page = secIdx / APP_CLOCK_CONFIG_PER_PAGES;
+  char digits[5], *start = text;
+  int i;
+
+  // Same as "%c %02u:%02u:%02u %u,%u\n", but faster
+  *text++ = commentchar;
+  *text++ = ' ';
+  *text++ = '0' + (hour / 10);
+  *text++ = '0' + (hour % 10);
+  *text++ = ':';
+  *text++ = '0' + (minute / 10);
+  *text++ = '0' + (minute % 10);
+  *text++ = ':';
+  *text++ = '0' + (second / 10);
+  *text++ = '0' + (second % 10);
+  *text++ = ' ';
+  i = 0;
+  do {
+    digits[i++] = '0' + (page % 10);
+    page /= 10;
+  } while(page);
+  while(i) {
+    *text++ = digits[--i];
+  }
+  *text++ = ',';
+  *text++ = '0' + (secIdx % APP_CLOCK_CONFIG_PER_PAGES);
+  *text++ = '\n';
+
+  return text - start;
+}
+
+/***********************************************************************************************************************
+ * Keep the description of a failed command on the device, return false if it failed
+ **********************************************************************************************************************/
+static bool ClockConfigCheckStatus(ClockConfigDeviceType *device, AppStatusType status)
+{
+  if(status != AppOk) {
+    snprintf(device->error, sizeof(device->error), "%s", AppGetError(device->app));
+    device->ioError = (status == AppIoError);
+    return false;
+  }
+
+  return true;
+}
+
+/***********************************************************************************************************************
+ * Exit with the description of the last failure on the device
+ **********************************************************************************************************************/
+static void ClockConfigExitOnDeviceError(ClockConfigDeviceType *device)
+{
+  if(!device->ioError) {
+    errno = 0;
+  }
+  ExitWithError("%s", device->error);
+}
+
+/***********************************************************************************************************************
+ * Read a page from the device and keep the mirror up to date, return false on failure
+ **********************************************************************************************************************/
+static bool ClockConfigReadPage(ClockConfigDeviceType *device, uint16_t page, AppClockMatrixBitmap matrixBitmap)
+{
+  AppFlashConfigPageType config;
+  double startTime = ProgressGetTime();
+
+  if(!ClockConfigCheckStatus(device, AppGetFlashConfigPage(device->app, page, &config))) {
+    return false;
+  }
+  ProgressAdd(device->progress, ProgressRead, startTime);
+  memcpy(matrixBitmap, config.matrixBitmap, sizeof(AppClockMatrixBitmap));
+  MirrorSetPage(device->mirror, page, config.matrixBitmap);
+
+  return true;
+}
+
+/***********************************************************************************************************************
+ * Check a page of the mirror against the device, drop the whole mirror on mismatch
+ * Returns false on failure, match tells if the page is the same.
+ **********************************************************************************************************************/
+static bool ClockConfigCheckMirrorPage(ClockConfigDeviceType *device, uint16_t page, bool *match)
+{
+  AppFlashConfigPageType config;
+  double startTime = ProgressGetTime();
+
+  if(!ClockConfigCheckStatus(device, AppGetFlashConfigPage(device->app, page, &config))) {
+    return false;
+  }
+  ProgressAdd(device->progress, ProgressRead, startTime);
+  *match = (memcmp(MirrorGetPage(device->mirror, page), config.matrixBitmap, sizeof(AppClockMatrixBitmap)) == 0);
+  if(!*match) {
+    // Device has been changed behind our back
+    MirrorInvalidate(device->mirror);
+  }
+
+  return true;
+}
+
+/***********************************************************************************************************************
+ * Check random pages of the mirror against the device, drop the whole mirror on mismatch, return false on failure
+ **********************************************************************************************************************/
+static bool ClockConfigCheckMirror(ClockConfigDeviceType *device, uint16_t firstPage, uint16_t lastPage, uint32_t samples)
+{
+  bool match = true;
+
+  srand(time(NULL));
+
+  while(match && samples--) {
+    uint16_t page = firstPage + (rand() % (lastPage - firstPage + 1));
+
+    if(MirrorIsSectorValid(device->mirror, page / APP_FLASH_PAGES_PER_SECTOR) &&
+       !ClockConfigCheckMirrorPage(device, page, &match)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 /***********************************************************************************************************************
  * Read Clock Configuration from device
+ * The selected seconds are read in order of the day, every page needed is read only once.
+ * If mirrorSamples is not negative, pages known by the local mirror are taken from it, after checking the given
+ * number of random pages against the device.
+ * With compact set the frames are collected and saved as container at the end.
  **********************************************************************************************************************/
-void ClockConfigRead(char *filename, bool binary, char *device, char *timestamp, char dotchar, char commentchar)
+void ClockConfigRead(char *filename, bool binary, char *deviceName, char *timestamp, char dotchar, char commentchar,
+  int32_t mirrorSamples, bool compact)
 {
-  uint32_t secIdx, to;
+  uint32_t secIdx, firstSecond, lastSecond, count;
+  uint16_t page, sector;
+  bool useMirror = (mirrorSamples >= 0), needDevice = !useMirror || (mirrorSamples > 0);
+  AppMatrixBitmapType *frames = NULL;
+  static bool selected[CLOCK_CONFIG_FRAMES];
 
-  // Convert timestamp to page information
-  ClockConfigParseTime(timestamp, &secIdx, &to);
+  // Convert timestamp to the set of seconds
+  count = ClockConfigParseTime(timestamp, selected);
+  for(firstSecond = 0; !selected[firstSecond]; firstSecond++);
+  for(lastSecond = CLOCK_CONFIG_FRAMES - 1; !selected[lastSecond]; lastSecond--);
 
   // Open file
   FILE *file = FileOpen(filename, true);
 
   // Check if we are writing binary data
-  if(binary) {
+  if(binary || compact) {
     FileCheckBinaryTerminal(file);
   }
+  // Containers hold consecutive frames
+  if(compact && (count != (lastSecond - firstSecond + 1))) {
+    ExitWithError("Container needs a single time range not wrapping around midnight");
+  }
+  if(compact && ((frames = malloc(count * sizeof(AppMatrixBitmapType))) == NULL)) {
+    ExitWithError("Out of memory");
+  }
+
+  // Open mirror and check if it can answer everything alone
+  ClockConfigDeviceType device = { .path = deviceName, .label = NULL };
+  device.mirror = MirrorOpen(deviceName);
+  for(sector = firstSecond / CLOCK_CONFIG_SECTOR_FRAMES;
+      !needDevice && (sector <= (lastSecond / CLOCK_CONFIG_SECTOR_FRAMES)); sector++) {
+    needDevice = (memchr(&selected[sector * CLOCK_CONFIG_SECTOR_FRAMES], true, CLOCK_CONFIG_SECTOR_FRAMES) != NULL) &&
+                 !MirrorIsSectorValid(device.mirror, sector);
+  }
 
   // Init device
-  AppInit(device);
+  device.app = needDevice ? OpenDevice(deviceName) : NULL;
+
+  // Count the pages to load
+  uint32_t pages = 0;
+  for(page = firstSecond / APP_CLOCK_CONFIG_PER_PAGES; page <= (lastSecond / APP_CLOCK_CONFIG_PER_PAGES); page++) {
+    pages += memchr(&selected[page * APP_CLOCK_CONFIG_PER_PAGES], true, APP_CLOCK_CONFIG_PER_PAGES) != NULL;
+  }
+  device.progress = ProgressStart(device.app, NULL, "Read", pages);
 
-  uint16_t oldPage = -1;
-  for(; secIdx <= to; secIdx++) {
-    AppFlashConfigPageType config;
-    uint16_t page = secIdx / APP_CLOCK_CONFIG_PER_PAGES;
+  if(useMirror && (mirrorSamples > 0) &&
+     !ClockConfigCheckMirror(&device, firstSecond / APP_CLOCK_CONFIG_PER_PAGES,
+       lastSecond / APP_CLOCK_CONFIG_PER_PAGES, mirrorSamples)) {
+    ClockConfigExitOnDeviceError(&device);
+  }
+
+  uint16_t oldPage = -1, oldSector = -1, sectorPagesRead = 0;
+  bool fromMirror = false;
+  AppClockMatrixBitmap matrixBitmap;
+  for(secIdx = firstSecond; secIdx <= lastSecond; secIdx++) {
     uint8_t pageSec = secIdx % APP_CLOCK_CONFIG_PER_PAGES;
+    page = secIdx / APP_CLOCK_CONFIG_PER_PAGES;
+    sector = page / APP_FLASH_PAGES_PER_SECTOR;
+
+    if(!selected[secIdx]) {
+      continue;
+    }
+
+    // Decide where the sector comes from
+    if(sector != oldSector) {
+      fromMirror = useMirror && MirrorIsSectorValid(device.mirror, sector);
+      oldSector = sector;
+      sectorPagesRead = 0;
+    }
 
     // Load page if necessary
     if(page != oldPage) {
-      AppGetFlashConfigPage(page, &config);
+      if(fromMirror) {
+        memcpy(matrixBitmap, MirrorGetPage(device.mirror, page), sizeof(matrixBitmap));
+      }
+      else {
+        if(!ClockConfigReadPage(&device, page, matrixBitmap)) {
+          ClockConfigExitOnDeviceError(&device);
+        }
+        // Mirror knows the sector once all of its pages are read
+        if(++sectorPagesRead == APP_FLASH_PAGES_PER_SECTOR) {
+          MirrorValidateSector(device.mirror, sector);
+        }
+      }
       oldPage = page;
+      ProgressAdvance(device.progress, 1);
     }
 
-    // Check if we are writing binary data
-    if(binary) {
-      FileWrite(file,
-        config.matrixBitmap[pageSec], sizeof(config.matrixBitmap[pageSec]));
+    // Check if we are writing a container or binary data
+    if(compact) {
+      memcpy(frames[secIdx - firstSecond], matrixBitmap[pageSec], sizeof(matrixBitmap[pageSec]));
+    }
+    else if(binary) {
+      FileWrite(file, matrixBitmap[pageSec], sizeof(matrixBitmap[pageSec]));
     }
     else {
-      // Calculate time
-      uint8_t hour   = secIdx / (60 * 60);
-      uint8_t minute = (secIdx / 60) % 60;
-      uint8_t second = secIdx % 60;
-      // Print header
-      fprintf(file, "%c %02u:%02u:%02u %u,%u\n", commentchar, hour, minute, second, page, pageSec);
-      // Print Config
-      BitmapPrint(file, config.matrixBitmap[pageSec], dotchar);
+      char text[CLOCK_CONFIG_MAX_FRAME_LENGTH];
+      // Print header and config
+      size_t length = ClockConfigFormatHeader(text, secIdx, commentchar);
+      length += BitmapFormat(text + length, matrixBitmap[pageSec], dotchar);
+      FileWrite(file, text, length);
     }
   }
 
+  ProgressFinish(device.progress);
+
+  if(compact) {
+    ContainerSave(file, frames, firstSecond, count);
+    free(frames);
+  }
+
   // Cleanup
-  AppCleanup();
+  if(needDevice) {
+    CloseDevice(device.app);
+  }
+  if(!MirrorClose(device.mirror)) {
+    fprintf(stderr, "Warning: Unable to close mirror\n");
+  }
   FileClose(file);
 }
 
 /***********************************************************************************************************************
- * Write Clock Configuration into device
+ * Load one page of a clock configuration from file
  **********************************************************************************************************************/
-void ClockConfigWrite(char *filename, bool binary, char *device, char dotchar, char commentchar)
+static void ClockConfigLoadPage(FILE *file, bool binary, char dotchar, char commentchar, AppClockMatrixBitmap page)
 {
-  // Open file
-  FILE *file = FileOpen(filename, false);
+  // Check if we are reading binary data
+  if(binary) {
+    FileRead(file, page, sizeof(AppClockMatrixBitmap));
+  }
+  else {
+    uint8_t pagesec;
+    for(pagesec = 0; pagesec < APP_CLOCK_CONFIG_PER_PAGES; pagesec++) {
+      if(BitmapRead(file, page[pagesec], dotchar, commentchar) != BITMAP_ROWS) {
+        ExitWithError("Invalid Input");
+      }
+    }
+  }
+}
 
-  // Check if we are writing binary data
+/***********************************************************************************************************************
+ * Load a whole clock configuration image from a container file, return false if the file holds no container
+ **********************************************************************************************************************/
+static bool ClockConfigLoadContainer(FILE *file, ClockConfigImageType image)
+{
+  ContainerType *container;
+  uint32_t frame;
+
+  if((container = ContainerLoad(file)) == NULL) {
+    return false;
+  }
+
+  if((ContainerGetFirstFrame(container) != 0) || (ContainerGetFrames(container) != CLOCK_CONFIG_FRAMES)) {
+    ExitWithError("Container does not hold %u frames", CLOCK_CONFIG_FRAMES);
+  }
+  for(frame = 0; frame < CLOCK_CONFIG_FRAMES; frame++) {
+    memcpy(image[frame / APP_CLOCK_CONFIG_PER_PAGES][frame % APP_CLOCK_CONFIG_PER_PAGES],
+      ContainerGetFrame(container, frame), sizeof(AppMatrixBitmapType));
+  }
+  ContainerFree(container);
+
+  return true;
+}
+
+/***********************************************************************************************************************
+ * Load a whole clock configuration image from file
+ **********************************************************************************************************************/
+static void ClockConfigLoadImage(FILE *file, bool binary, char dotchar, char commentchar, ClockConfigImageType image)
+{
+  if(ClockConfigLoadContainer(file, image)) {
+    return;
+  }
+
+  // Check if we are reading binary data
   if(binary) {
     FileCheckBinaryTerminal(file);
+    FileRead(file, image, sizeof(ClockConfigImageType));
+  }
+  else {
+    uint16_t page;
+    for(page = 0; page < APP_CLOCK_CONFIG_FLASH_PAGES; page++) {
+      ClockConfigLoadPage(file, binary, dotchar, commentchar, image[page]);
+    }
   }
+}
 
-  // Init device
-  AppInit(device);
+/***********************************************************************************************************************
+ * Parse a text file mapped into memory on all processors into an image
+ * Returns the number of bitmap lines in the file or -1 if the file can not be mapped.
+ **********************************************************************************************************************/
+static int64_t ClockConfigParseMapped(FILE *file, char dotchar, char commentchar, ClockConfigImageType image)
+{
+  const char *text;
+  size_t length;
+  uint32_t lines;
+
+  if((text = FileMap(file, &length)) == NULL) {
+    return -1;
+  }
+
+  lines = ParserReadBitmaps(text, length, (AppMatrixBitmapType *)image, CLOCK_CONFIG_FRAMES, dotchar, commentchar);
+  FileUnmap(text, length);
+
+  return lines;
+}
 
-  // Loop all pages
+/***********************************************************************************************************************
+ * Load a clock face template
+ **********************************************************************************************************************/
+static GeneratorType *ClockConfigLoadTemplate(char *templateFilename)
+{
+  FILE *file = FileOpen(templateFilename, false);
+  GeneratorType *generator = GeneratorLoad(file);
+  FileClose(file);
+
+  return generator;
+}
+
+/***********************************************************************************************************************
+ * Publish the number of pages loaded and the hash over them to the writer
+ **********************************************************************************************************************/
+static void ClockConfigPublishPages(ClockConfigProducerType *producer, uint16_t pages, Hash64Type hash)
+{
+  pthread_mutex_lock(&producer->lock);
+  producer->pagesReady = pages;
+  producer->hash = hash;
+  pthread_cond_broadcast(&producer->ready);
+  pthread_mutex_unlock(&producer->lock);
+}
+
+/***********************************************************************************************************************
+ * Producer thread: load (or generate) the image sector by sector and publish the number of pages ready
+ **********************************************************************************************************************/
+static void *ClockConfigProducer(void *arg)
+{
+  ClockConfigProducerType *producer = arg;
+  ClockConfigImageType *image = producer->image;
+  Hash64Type hash = HASH64_INIT;
+  int64_t lines;
   uint16_t page;
+
+  // Render generated clock faces on all processors at once
+  if(producer->generator != NULL) {
+    GeneratorRenderFrames(producer->generator, (AppMatrixBitmapType *)image, CLOCK_CONFIG_FRAMES);
+    ClockConfigPublishPages(producer, APP_CLOCK_CONFIG_FLASH_PAGES,
+      Hash64CalculateBuffer(image, sizeof(ClockConfigImageType)));
+    return NULL;
+  }
+
+  // Containers are loaded at once
+  if(ClockConfigLoadContainer(producer->file, *image)) {
+    ClockConfigPublishPages(producer, APP_CLOCK_CONFIG_FLASH_PAGES,
+      Hash64CalculateBuffer(image, sizeof(ClockConfigImageType)));
+    return NULL;
+  }
+
+  // Parse mapped text files on all processors at once
+  if(!producer->binary &&
+     ((lines = ClockConfigParseMapped(producer->file, producer->dotchar, producer->commentchar, *image)) >= 0)) {
+    if(lines < CLOCK_CONFIG_TEXT_LINES) {
+      ExitWithError("Invalid Input");
+    }
+    ClockConfigPublishPages(producer, APP_CLOCK_CONFIG_FLASH_PAGES,
+      Hash64CalculateBuffer(image, sizeof(ClockConfigImageType)));
+    return NULL;
+  }
+
+  // Otherwise read page by page
   for(page = 0; page < APP_CLOCK_CONFIG_FLASH_PAGES; page++) {
-    AppFlashClockConfigType config;
+    ClockConfigLoadPage(producer->file, producer->binary, producer->dotchar, producer->commentchar, (*image)[page]);
+    hash = Hash64Update(hash, (*image)[page], sizeof(AppClockMatrixBitmap));
 
-    // Erase pages if necessary
-    if((page % APP_FLASH_PAGES_PER_SECTOR) == 0) {
-      AppEraseFlashConfigSector(page);
+    // Publish every finished sector
+    if(((page + 1) % APP_FLASH_PAGES_PER_SECTOR) == 0) {
+      ClockConfigPublishPages(producer, page + 1, hash);
     }
+  }
+
+  return NULL;
+}
 
-    // Read config data page
-    if(binary) {
-      FileRead(file, &(config.matrixBitmap), sizeof(config.matrixBitmap));
+/***********************************************************************************************************************
+ * Close the input of the producer
+ **********************************************************************************************************************/
+static void ClockConfigCloseProducer(ClockConfigProducerType *producer)
+{
+  if(producer->file != NULL) {
+    FileClose(producer->file);
+  }
+  if(producer->generator != NULL) {
+    GeneratorFree(producer->generator);
+  }
+}
+
+/***********************************************************************************************************************
+ * Wait until the producer has loaded at least the given number of pages, return the number of pages loaded
+ **********************************************************************************************************************/
+static uint16_t ClockConfigWaitForPages(ClockConfigProducerType *producer, uint16_t pages)
+{
+  pthread_mutex_lock(&producer->lock);
+  while(producer->pagesReady < pages) {
+    pthread_cond_wait(&producer->ready, &producer->lock);
+  }
+  pages = producer->pagesReady;
+  pthread_mutex_unlock(&producer->lock);
+
+  return pages;
+}
+
+/***********************************************************************************************************************
+ * Check if a page can be programmed over the current contents without erase (NOR flash can only clear bits)
+ **********************************************************************************************************************/
+static bool ClockConfigPageProgrammable(const AppClockMatrixBitmap newPage, const AppClockMatrixBitmap oldPage)
+{
+  const uint8_t *newBytes = (const uint8_t *)newPage, *oldBytes = (const uint8_t *)oldPage;
+  size_t i;
+
+  for(i = 0; i < sizeof(AppClockMatrixBitmap); i++) {
+    if(newBytes[i] & ~oldBytes[i]) {
+      return false;
     }
-    else {
-      uint8_t pagesec;
-      for(pagesec = 0; pagesec < APP_CLOCK_CONFIG_PER_PAGES; pagesec++) {
-        if(BitmapRead(file, config.matrixBitmap[pagesec], dotchar, commentchar) != false) {
-          ExitWithError("Invalid Input");
+  }
+
+  return true;
+}
+
+/***********************************************************************************************************************
+ * Check if a page holds the erased state of the flash
+ **********************************************************************************************************************/
+static bool ClockConfigPageErased(const AppClockMatrixBitmap page)
+{
+  const uint8_t *bytes = (const uint8_t *)page;
+  size_t i;
+
+  for(i = 0; i < sizeof(AppClockMatrixBitmap); i++) {
+    if(bytes[i] != 0xFF) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/***********************************************************************************************************************
+ * Check if the mirror knows a sector, after comparing a random page of it with the device. A unit written from
+ * elsewhere (or replaced by another one on the same path) makes the whole mirror unknown, as in ClockConfigCheckMirror.
+ * Returns false on failure, trusted tells if the mirror can be used.
+ **********************************************************************************************************************/
+static bool ClockConfigTrustMirrorSector(ClockConfigDeviceType *device, uint16_t sector, bool *trusted)
+{
+  uint16_t page = (sector * APP_FLASH_PAGES_PER_SECTOR) + (rand() % APP_FLASH_PAGES_PER_SECTOR);
+
+  *trusted = false;
+  return !MirrorIsSectorValid(device->mirror, sector) || ClockConfigCheckMirrorPage(device, page, trusted);
+}
+
+/***********************************************************************************************************************
+ * Decide how a sector has to be written, based on the device contents (given base image, local mirror or read back)
+ * For program only sectors the current contents are returned in current. Returns false on failure.
+ **********************************************************************************************************************/
+static bool ClockConfigPlanSector(ClockConfigDeviceType *device, ClockConfigImageType image, ClockConfigImageType base,
+  uint16_t startPage, AppClockMatrixBitmap current[APP_FLASH_PAGES_PER_SECTOR], ClockConfigSectorPlanType *plan)
+{
+  uint16_t page, sector = startPage / APP_FLASH_PAGES_PER_SECTOR;
+  bool fromDevice = false, trusted;
+
+  *plan = ClockConfigSectorUnchanged;
+
+  // Get the current contents from the cached image of the device, the local mirror or the device itself
+  if(base != NULL) {
+    memcpy(current, base[startPage], sizeof(AppClockMatrixBitmap) * APP_FLASH_PAGES_PER_SECTOR);
+  }
+  else if(!ClockConfigTrustMirrorSector(device, sector, &trusted)) {
+    return false;
+  }
+  else if(trusted) {
+    memcpy(current, MirrorGetPage(device->mirror, startPage), sizeof(AppClockMatrixBitmap) * APP_FLASH_PAGES_PER_SECTOR);
+  }
+  else {
+    fromDevice = true;
+  }
+
+  for(page = 0; page < APP_FLASH_PAGES_PER_SECTOR; page++) {
+    if(fromDevice && !ClockConfigReadPage(device, startPage + page, current[page])) {
+      return false;
+    }
+    if(memcmp(image[startPage + page], current[page], sizeof(AppClockMatrixBitmap)) != 0) {
+      // Erase needed, the rest of the sector does not matter any more
+      if(!ClockConfigPageProgrammable(image[startPage + page], current[page])) {
+        *plan = ClockConfigSectorEraseProgram;
+        return true;
+      }
+      *plan = ClockConfigSectorProgram;
+    }
+  }
+
+  if(fromDevice) {
+    MirrorValidateSector(device->mirror, sector);
+  }
+
+  return true;
+}
+
+/***********************************************************************************************************************
+ * Write one sector of the clock configuration according to its plan, count the pages written in written
+ * Erased sectors get all pages written except the ones staying erased, program only sectors get the changed pages.
+ * Returns false on failure.
+ **********************************************************************************************************************/
+static bool ClockConfigWriteSector(ClockConfigDeviceType *device, ClockConfigImageType image, uint16_t startPage,
+  ClockConfigSectorPlanType plan, AppClockMatrixBitmap current[APP_FLASH_PAGES_PER_SECTOR], uint32_t *written)
+{
+  uint16_t page, sector = startPage / APP_FLASH_PAGES_PER_SECTOR;
+  double startTime;
+
+  if(plan == ClockConfigSectorUnchanged) {
+    return true;
+  }
+
+  // Mirror does not know the sector until it is completely written
+  MirrorInvalidateSector(device->mirror, sector);
+  if(plan == ClockConfigSectorEraseProgram) {
+    startTime = ProgressGetTime();
+    if(!ClockConfigCheckStatus(device, AppEraseFlashConfigSector(device->app, startPage))) {
+      return false;
+    }
+    ProgressAdd(device->progress, ProgressErase, startTime);
+  }
+
+  for(page = startPage; page < (startPage + APP_FLASH_PAGES_PER_SECTOR); page++) {
+    bool needed = (plan == ClockConfigSectorEraseProgram) ?
+      !ClockConfigPageErased(image[page]) :
+      (memcmp(image[page], current[page - startPage], sizeof(AppClockMatrixBitmap)) != 0);
+
+    if(needed) {
+      AppFlashClockConfigType config;
+
+      // Set page number and write page
+      config.pageNumber = page;
+      memcpy(config.matrixBitmap, image[page], sizeof(config.matrixBitmap));
+      startTime = ProgressGetTime();
+      if(!ClockConfigCheckStatus(device, AppSetFlashClockConfig(device->app, &config))) {
+        return false;
+      }
+      ProgressAdd(device->progress, ProgressProgram, startTime);
+      (*written)++;
+    }
+    MirrorSetPage(device->mirror, page, image[page]);
+  }
+
+  MirrorValidateSector(device->mirror, sector);
+  return true;
+}
+
+/***********************************************************************************************************************
+ * Read back pages of a sector and compare them with the image, verified is the number of pages read or 0 on mismatch
+ * With samples > 0 only so many randomly chosen pages are checked, otherwise the whole sector. Returns false on failure.
+ **********************************************************************************************************************/
+static bool ClockConfigVerifySector(ClockConfigDeviceType *device, ClockConfigImageType image, uint16_t startPage,
+  uint32_t samples, uint16_t *verified)
+{
+  uint16_t pages[APP_FLASH_PAGES_PER_SECTOR], count = APP_FLASH_PAGES_PER_SECTOR, i;
+
+  for(i = 0; i < APP_FLASH_PAGES_PER_SECTOR; i++) {
+    pages[i] = startPage + i;
+  }
+  // Pick random pages by shuffling the front of the list
+  if((samples > 0) && (samples < APP_FLASH_PAGES_PER_SECTOR)) {
+    count = samples;
+    for(i = 0; i < count; i++) {
+      uint16_t j = i + (rand() % (APP_FLASH_PAGES_PER_SECTOR - i)), page = pages[j];
+      pages[j] = pages[i];
+      pages[i] = page;
+    }
+  }
+
+  *verified = 0;
+  for(i = 0; i < count; i++) {
+    AppClockMatrixBitmap matrixBitmap;
+
+    if(!ClockConfigReadPage(device, pages[i], matrixBitmap)) {
+      return false;
+    }
+    if(memcmp(matrixBitmap, image[pages[i]], sizeof(AppClockMatrixBitmap)) != 0) {
+      return true;
+    }
+  }
+
+  *verified = count;
+  return true;
+}
+
+/***********************************************************************************************************************
+ * Print number of pages transferred and throughput of a phase on a device
+ **********************************************************************************************************************/
+static void ClockConfigPrintThroughput(ClockConfigDeviceType *device, const char *phase, uint32_t pages, double seconds)
+{
+  double bytes = (double)pages * sizeof(AppClockMatrixBitmap);
+
+  fprintf(stderr, "%s%s%s: %u pages, %.0f bytes in %.2f s (%.0f B/s)\n", device->label ? device->label : "",
+    device->label ? " " : "", phase, pages, bytes, seconds, (seconds > 0) ? (bytes / seconds) : 0);
+}
+
+/***********************************************************************************************************************
+ * Read back written sectors (all or the ones covered by selected seconds), rewrite the ones not matching the image and
+ * print write and verify statistics. Returns false on failure.
+ **********************************************************************************************************************/
+static bool ClockConfigVerify(ClockConfigDeviceType *device, ClockConfigImageType image,
+  const uint8_t covered[CLOCK_CONFIG_SECTORS], int32_t verifySamples, uint32_t pagesWritten, double writeTime)
+{
+  uint32_t pagesVerified = 0, sectorsRepaired = 0, sectors = 0;
+  double verifyTime = 0, repairStartTime, startTime;
+  uint16_t page;
+
+  for(page = 0; page < APP_CLOCK_CONFIG_FLASH_PAGES; page += APP_FLASH_PAGES_PER_SECTOR) {
+    sectors += (covered == NULL) || covered[page / APP_FLASH_PAGES_PER_SECTOR];
+  }
+  device->progress = ProgressStart(device->app, device->label, "Verify",
+    sectors * (((verifySamples > 0) && (verifySamples < APP_FLASH_PAGES_PER_SECTOR)) ?
+    verifySamples : APP_FLASH_PAGES_PER_SECTOR));
+
+  startTime = ProgressGetTime();
+  for(page = 0; page < APP_CLOCK_CONFIG_FLASH_PAGES; page += APP_FLASH_PAGES_PER_SECTOR) {
+    uint16_t retries, verified;
+    uint32_t samples = verifySamples;
+
+    if((covered != NULL) && !covered[page / APP_FLASH_PAGES_PER_SECTOR]) {
+      continue;
+    }
+
+    for(retries = 0;; retries++) {
+      if(!ClockConfigVerifySector(device, image, page, samples, &verified)) {
+        return false;
+      }
+      if(verified) {
+        break;
+      }
+      if(retries == CLOCK_CONFIG_VERIFY_RETRIES) {
+        snprintf(device->error, sizeof(device->error), "Verification of sector %u failed",
+          page / APP_FLASH_PAGES_PER_SECTOR);
+        device->ioError = false;
+        return false;
+      }
+      // Rewrite the whole sector, repair time counts as write time
+      repairStartTime = ProgressGetTime();
+      verifyTime += repairStartTime - startTime;
+      if(!ClockConfigWriteSector(device, image, page, ClockConfigSectorEraseProgram, NULL, &pagesWritten)) {
+        return false;
+      }
+      startTime = ProgressGetTime();
+      writeTime += startTime - repairStartTime;
+      sectorsRepaired++;
+      // Check the whole sector after repair
+      samples = 0;
+    }
+    pagesVerified += verified;
+    ProgressAdvance(device->progress, verified);
+  }
+  verifyTime += ProgressGetTime() - startTime;
+  ProgressFinish(device->progress);
+  device->progress = NULL;
+
+  ClockConfigPrintThroughput(device, "Write", pagesWritten, writeTime);
+  ClockConfigPrintThroughput(device, "Verify", pagesVerified, verifyTime);
+  fprintf(stderr, "%s%sRepaired %u sectors\n", device->label ? device->label : "", device->label ? " " : "",
+    sectorsRepaired);
+
+  return true;
+}
+
+/***********************************************************************************************************************
+ * Load the frames of the selected seconds (given in order of the day) into their place in the image
+ * Containers are looked up by second, other inputs hold just the selected frames.
+ **********************************************************************************************************************/
+static void ClockConfigLoadSelected(char *filename, bool binary, char *templateFilename, char dotchar,
+  char commentchar, const bool selected[CLOCK_CONFIG_FRAMES], ClockConfigImageType image)
+{
+  GeneratorType *generator = NULL;
+  ContainerType *container = NULL;
+  FILE *file = NULL;
+  uint32_t secIdx;
+
+  if(templateFilename != NULL) {
+    generator = ClockConfigLoadTemplate(templateFilename);
+  }
+  else {
+    file = FileOpen(filename, false);
+    if(((container = ContainerLoad(file)) == NULL) && binary) {
+      FileCheckBinaryTerminal(file);
+    }
+  }
+
+  for(secIdx = 0; secIdx < CLOCK_CONFIG_FRAMES; secIdx++) {
+    uint8_t *bitmap = image[secIdx / APP_CLOCK_CONFIG_PER_PAGES][secIdx % APP_CLOCK_CONFIG_PER_PAGES];
+    const uint8_t *frame;
+
+    if(!selected[secIdx]) {
+      continue;
+    }
+
+    if(generator != NULL) {
+      GeneratorRender(generator, secIdx, bitmap);
+    }
+    else if(container != NULL) {
+      if((frame = ContainerGetFrame(container, secIdx)) == NULL) {
+        ExitWithError("Container does not hold frame %u", secIdx);
+      }
+      memcpy(bitmap, frame, sizeof(AppMatrixBitmapType));
+    }
+    else if(binary) {
+      FileRead(file, bitmap, sizeof(AppMatrixBitmapType));
+    }
+    else if(BitmapRead(file, bitmap, dotchar, commentchar) != BITMAP_ROWS) {
+      ExitWithError("Invalid Input");
+    }
+  }
+
+  if(generator != NULL) {
+    GeneratorFree(generator);
+  }
+  if(container != NULL) {
+    ContainerFree(container);
+  }
+  if(file != NULL) {
+    FileClose(file);
+  }
+}
+
+/***********************************************************************************************************************
+ * Fill the frames of a sector not selected for writing with the device contents (given base image, local mirror or
+ * read back), return false on failure
+ **********************************************************************************************************************/
+static bool ClockConfigMergeSector(ClockConfigDeviceType *device, ClockConfigImageType image, ClockConfigImageType base,
+  uint16_t startPage, const bool selected[CLOCK_CONFIG_FRAMES])
+{
+  uint16_t page, sector = startPage / APP_FLASH_PAGES_PER_SECTOR;
+  bool fromDevice = false, trusted;
+  uint8_t pageSec;
+
+  if(base == NULL) {
+    if(!ClockConfigTrustMirrorSector(device, sector, &trusted)) {
+      return false;
+    }
+    fromDevice = !trusted;
+  }
+
+  for(page = startPage; page < (startPage + APP_FLASH_PAGES_PER_SECTOR); page++) {
+    AppClockMatrixBitmap current;
+
+    if(base != NULL) {
+      memcpy(current, base[page], sizeof(current));
+    }
+    else if(!fromDevice) {
+      memcpy(current, MirrorGetPage(device->mirror, page), sizeof(current));
+    }
+    else if(!ClockConfigReadPage(device, page, current)) {
+      return false;
+    }
+
+    for(pageSec = 0; pageSec < APP_CLOCK_CONFIG_PER_PAGES; pageSec++) {
+      if(!selected[(page * APP_CLOCK_CONFIG_PER_PAGES) + pageSec]) {
+        memcpy(image[page][pageSec], current[pageSec], sizeof(AppMatrixBitmapType));
+      }
+    }
+  }
+
+  if(fromDevice) {
+    MirrorValidateSector(device->mirror, sector);
+  }
+
+  return true;
+}
+
+/***********************************************************************************************************************
+ * Record a written sector in the journal of the device. A journal that can not be written is removed and the write
+ * goes on without it, an interrupted one can not be resumed then.
+ **********************************************************************************************************************/
+static void ClockConfigRecordSector(ClockConfigDeviceType *device, uint16_t sector)
+{
+  if((device->journal != NULL) && !JournalSetSectorDone(device->journal, sector)) {
+    fprintf(stderr, "%s%sWarning: Unable to write journal, an interrupted write can not be resumed\n",
+      device->label ? device->label : "", device->label ? ": " : "");
+    JournalClose(device->journal, true);
+    device->journal = NULL;
+  }
+}
+
+/***********************************************************************************************************************
+ * Open the journal of the image on the device once the image is complete, record the sectors before the given one as
+ * written. Without a journal the write goes on (an interrupted one can not be resumed then), unless resuming.
+ * Returns false on failure.
+ **********************************************************************************************************************/
+static bool ClockConfigOpenJournal(ClockConfigDeviceType *device, uint16_t sector)
+{
+  ClockConfigJobType *job = device->job;
+  uint16_t sectorDone;
+  bool resumed;
+
+  device->journal = JournalOpen(Hash64Update(job->producer->hash, device->path, strlen(device->path)), job->resume,
+    &resumed);
+  if(device->journal == NULL) {
+    if(job->resume) {
+      snprintf(device->error, sizeof(device->error), "Unable to open journal");
+      device->ioError = false;
+      return false;
+    }
+    fprintf(stderr, "%s%sWarning: Unable to open journal, an interrupted write can not be resumed\n",
+      device->label ? device->label : "", device->label ? ": " : "");
+  }
+  else if(job->resume && !resumed) {
+    fprintf(stderr, "%s%sWarning: No journal of an interrupted write of this image, starting from sector 0\n",
+      device->label ? device->label : "", device->label ? ": " : "");
+  }
+  device->journalTried = true;
+
+  // Record what has been written so far
+  for(sectorDone = 0; !job->resume && (sectorDone < sector); sectorDone++) {
+    ClockConfigRecordSector(device, sectorDone);
+  }
+
+  return true;
+}
+
+/***********************************************************************************************************************
+ * Write the image into one device, return false on failure
+ * Writing the whole day, every sector is written as soon as the producer has loaded it and written sectors are
+ * recorded in the journal. Otherwise only the sectors holding selected seconds are written, partly selected ones are
+ * merged with the device contents.
+ **********************************************************************************************************************/
+static bool ClockConfigWriteDevice(ClockConfigDeviceType *device)
+{
+  ClockConfigJobType *job = device->job;
+  AppClockMatrixBitmap *image = *device->image, *base = job->base ? *job->base : NULL;
+  uint32_t pagesWritten = 0;
+  uint16_t page, sectors = 0;
+  double startTime;
+
+  if((device->app = AppInit(device->path)) == NULL) {
+    snprintf(device->error, sizeof(device->error), "Could not open device: %s", device->path);
+    device->ioError = true;
+    return false;
+  }
+
+  for(page = 0; page < CLOCK_CONFIG_SECTORS; page++) {
+    sectors += (job->covered == NULL) || (job->covered[page] > 0);
+  }
+
+  startTime = ProgressGetTime();
+  device->progress = ProgressStart(device->app, device->label, "Write", sectors * APP_FLASH_PAGES_PER_SECTOR);
+  for(page = 0; page < APP_CLOCK_CONFIG_FLASH_PAGES; page += APP_FLASH_PAGES_PER_SECTOR) {
+    uint16_t sector = page / APP_FLASH_PAGES_PER_SECTOR;
+    AppClockMatrixBitmap current[APP_FLASH_PAGES_PER_SECTOR];
+    ClockConfigSectorPlanType plan = ClockConfigSectorEraseProgram;
+
+    if(job->selected != NULL) {
+      if(job->covered[sector] == 0) {
+        continue;
+      }
+      // Partly selected sectors are merged with the device contents (base image, mirror or read back, which leaves the
+      // sector in the mirror), planning reuses them from there and only checks one more page on the device
+      if(job->covered[sector] < CLOCK_CONFIG_SECTOR_FRAMES) {
+        if(!ClockConfigMergeSector(device, image, base, page, job->selected) ||
+           !ClockConfigPlanSector(device, image, base, page, current, &plan)) {
+          return false;
         }
       }
+      else if(job->diff && !ClockConfigPlanSector(device, image, base, page, current, &plan)) {
+        return false;
+      }
+    }
+    else {
+      // The journal belongs to this image on this device, so it can only be opened once the whole image is loaded.
+      // When resuming this has to happen before anything is written, otherwise as soon as the image is complete.
+      uint16_t pagesReady = ClockConfigWaitForPages(job->producer,
+        job->resume ? APP_CLOCK_CONFIG_FLASH_PAGES : (page + APP_FLASH_PAGES_PER_SECTOR));
+      if(!device->journalTried && (pagesReady == APP_CLOCK_CONFIG_FLASH_PAGES) &&
+         !ClockConfigOpenJournal(device, sector)) {
+        return false;
+      }
+
+      // Skip sectors already written by a previous run or attempt
+      if((device->journal != NULL) && JournalIsSectorDone(device->journal, sector)) {
+        ProgressAdvance(device->progress, APP_FLASH_PAGES_PER_SECTOR);
+        continue;
+      }
+
+      if(job->diff && !ClockConfigPlanSector(device, image, base, page, current, &plan)) {
+        return false;
+      }
+    }
+
+    if(!ClockConfigWriteSector(device, image, page, plan, current, &pagesWritten)) {
+      return false;
+    }
+    ClockConfigRecordSector(device, sector);
+    ProgressAdvance(device->progress, APP_FLASH_PAGES_PER_SECTOR);
+  }
+  ProgressFinish(device->progress);
+  device->progress = NULL;
+
+  // Read back and repair
+  return (job->verifySamples < 0) ||
+    ClockConfigVerify(device, image, job->covered, job->verifySamples, pagesWritten, ProgressGetTime() - startTime);
+}
+
+/***********************************************************************************************************************
+ * Writer of one device: write the image, write it again after a failure as often as the job allows
+ * Mirror and journal stay open between the attempts, so sectors already written are not written again.
+ **********************************************************************************************************************/
+static void *ClockConfigWriter(void *arg)
+{
+  ClockConfigDeviceType *device = arg;
+  uint8_t attempt;
+  bool done;
+
+  device->mirror = MirrorOpen(device->path);
+  for(attempt = 0;; attempt++) {
+    done = ClockConfigWriteDevice(device);
+    // A failed attempt leaves its task and connection behind, the connection is given up whatever closing it says
+    if(device->progress != NULL) {
+      ProgressFinish(device->progress);
+      device->progress = NULL;
+    }
+    if(device->app != NULL) {
+      AppCleanup(device->app);
+      device->app = NULL;
+    }
+    if(done || (attempt == device->job->retries)) {
+      break;
+    }
+    fprintf(stderr, "%s: %s, retrying\n", device->path, device->error);
+    // Let the device finish answering the interrupted command
+    usleep(CLOCK_CONFIG_RETRY_DELAY);
+  }
+
+  if((device->journal != NULL) && !JournalClose(device->journal, done)) {
+    fprintf(stderr, "%s%sWarning: Unable to clean up journal\n", device->label ? device->label : "",
+      device->label ? ": " : "");
+  }
+  if(!MirrorClose(device->mirror)) {
+    fprintf(stderr, "%s%sWarning: Unable to close mirror\n", device->label ? device->label : "",
+      device->label ? ": " : "");
+  }
+  device->failed = !done;
+
+  if(device->label != NULL) {
+    if(done) {
+      fprintf(stderr, "%s: done\n", device->label);
+    }
+    else {
+      fprintf(stderr, "%s: failed: %s\n", device->label, device->error);
+    }
+  }
+
+  return NULL;
+}
+
+/***********************************************************************************************************************
+ * Write Clock Configuration into device
+ * The input is parsed (or generated from a template) by a producer thread while already loaded sectors are transmitted.
+ * In diff mode the device contents (from the given base image, the local mirror or read back) are used to plan every
+ * sector: unchanged sectors are skipped, sectors where only bits are cleared get their changed pages programmed
+ * without erase, the rest is erased and programmed.
+ * Written sectors are recorded in a journal, so an interrupted upload of the same image can be resumed.
+ * With verifySamples >= 0 every sector is read back afterwards (only so many random pages of it if not 0) and
+ * sectors not matching the image are rewritten.
+ * If the timestamp does not select the whole day, only the sectors holding the selected seconds are written.
+ * Several devices (comma separated) are written in parallel, each by its own thread following the producer. A failed
+ * device is written again without stopping the others.
+ **********************************************************************************************************************/
+void ClockConfigWrite(char *filename, bool binary, char *templateFilename, char *deviceNames, char *timestamp, char dotchar,
+  char commentchar, bool diff, char *baseFilename, bool resume, int32_t verifySamples)
+{
+  static bool selected[CLOCK_CONFIG_FRAMES];
+  static uint8_t covered[CLOCK_CONFIG_SECTORS];
+  static ClockConfigDeviceType devices[CLOCK_CONFIG_MAX_DEVICES];
+  ClockConfigImageType *image, *base = NULL;
+  ClockConfigProducerType producer = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .ready = PTHREAD_COND_INITIALIZER,
+    .binary = binary,
+    .dotchar = dotchar,
+    .commentchar = commentchar,
+    .generator = NULL,
+    .file = NULL,
+    .pagesReady = 0
+  };
+  ClockConfigJobType job = {
+    .producer = &producer,
+    .selected = NULL,
+    .covered = NULL,
+    .diff = diff,
+    .resume = resume,
+    .verifySamples = verifySamples
+  };
+  pthread_t producerThread;
+  bool producerRunning = false, merge = false;
+  uint16_t count = 0, failed = 0, i;
+  uint32_t frame;
+  char *rest;
+
+  // Pages of mirror sectors to check against the device
+  srand(time(NULL));
+
+  // Load the image of the actual device contents (binary only)
+  if(diff && (baseFilename != NULL)) {
+    if((base = malloc(sizeof(ClockConfigImageType))) == NULL) {
+      ExitWithError("Out of memory");
+    }
+    FILE *file = FileOpen(baseFilename, false);
+    ClockConfigLoadImage(file, true, dotchar, commentchar, *base);
+    FileClose(file);
+  }
+  job.base = base;
+
+  if((image = malloc(sizeof(ClockConfigImageType))) == NULL) {
+    ExitWithError("Out of memory");
+  }
+  producer.image = image;
+
+  // Write only part of the day, the frames are loaded at once
+  if(ClockConfigParseTime(timestamp, selected) < CLOCK_CONFIG_FRAMES) {
+    if(resume) {
+      ExitWithError("Resume needs the whole day to be written");
+    }
+    ClockConfigLoadSelected(filename, binary, templateFilename, dotchar, commentchar, selected, *image);
+    producer.pagesReady = APP_CLOCK_CONFIG_FLASH_PAGES;
+
+    // Find the sectors holding selected seconds
+    for(frame = 0; frame < CLOCK_CONFIG_FRAMES; frame++) {
+      covered[frame / CLOCK_CONFIG_SECTOR_FRAMES] += selected[frame];
+    }
+    for(i = 0; i < CLOCK_CONFIG_SECTORS; i++) {
+      merge |= (covered[i] > 0) && (covered[i] < CLOCK_CONFIG_SECTOR_FRAMES);
+    }
+    job.selected = selected;
+    job.covered = covered;
+  }
+  // Start loading new configuration
+  else {
+    if(templateFilename != NULL) {
+      producer.generator = ClockConfigLoadTemplate(templateFilename);
+    }
+    else {
+      producer.file = FileOpen(filename, false);
+      if(binary) {
+        FileCheckBinaryTerminal(producer.file);
+      }
+    }
+    if(pthread_create(&producerThread, NULL, ClockConfigProducer, &producer) != 0) {
+      ExitWithError("Unable to start producer thread");
     }
+    producerRunning = true;
+  }
 
-    // Set page number and write page
-    config.pageNumber = page;
-    AppSetFlashClockConfig(&config);
+  // Split the device list
+  for(devices[0].path = strtok_r(deviceNames, ",", &rest); devices[count].path != NULL;
+      devices[count].path = strtok_r(NULL, ",", &rest)) {
+    if(++count == CLOCK_CONFIG_MAX_DEVICES) {
+      ExitWithError("More than %u devices", CLOCK_CONFIG_MAX_DEVICES - 1);
+    }
+  }
+  if(count == 0) {
+    ExitWithError("No device given");
+  }
+
+  job.retries = (count > 1) ? CLOCK_CONFIG_DEVICE_RETRIES : 0;
+  for(i = 0; i < count; i++) {
+    devices[i].label = (count > 1) ? devices[i].path : NULL;
+    devices[i].job = &job;
+    devices[i].image = image;
+    // Partly selected sectors get the contents of the device they are written to merged in
+    if(merge && (count > 1)) {
+      if((devices[i].image = malloc(sizeof(ClockConfigImageType))) == NULL) {
+        ExitWithError("Out of memory");
+      }
+      memcpy(devices[i].image, image, sizeof(ClockConfigImageType));
+    }
+  }
+
+  // A single device is written right here, several ones by a thread each
+  if(count == 1) {
+    ClockConfigWriter(&devices[0]);
+    if(devices[0].failed) {
+      ClockConfigExitOnDeviceError(&devices[0]);
+    }
+  }
+  else {
+    for(i = 0; i < count; i++) {
+      if(pthread_create(&devices[i].thread, NULL, ClockConfigWriter, &devices[i]) != 0) {
+        ExitWithError("Unable to start writer thread for device: %s", devices[i].path);
+      }
+    }
+    for(i = 0; i < count; i++) {
+      pthread_join(devices[i].thread, NULL);
+      failed += devices[i].failed;
+      if(devices[i].image != image) {
+        free(devices[i].image);
+      }
+    }
+  }
+  if(producerRunning) {
+    pthread_join(producerThread, NULL);
+  }
+
+  if(failed > 0) {
+    errno = 0;
+    ExitWithError("Writing failed on %u of %u devices", failed, count);
   }
 
   // Cleanup
-  AppCleanup();
+  ClockConfigCloseProducer(&producer);
+  free(base);
+  free(image);
+}
+
+/***********************************************************************************************************************
+ * Worker: format frames as text into their slots
+ **********************************************************************************************************************/
+static void ClockConfigFormatFrames(void *context, uint32_t start, uint32_t end)
+{
+  ClockConfigFormatterType *formatter = context;
+
+  for(; start < end; start++) {
+    char *text = formatter->text + ((size_t)start * CLOCK_CONFIG_MAX_FRAME_LENGTH);
+    size_t length = ClockConfigFormatHeader(text, start, formatter->commentchar);
+    formatter->lengths[start] = length +
+      BitmapFormat(text + length, formatter->image[start / APP_CLOCK_CONFIG_PER_PAGES][start % APP_CLOCK_CONFIG_PER_PAGES],
+        formatter->dotchar);
+  }
+}
+
+/***********************************************************************************************************************
+ * Load and check a whole clock configuration to convert, containers are detected by their header
+ **********************************************************************************************************************/
+static void ClockConfigLoadInput(FILE *file, bool binary, char dotchar, char commentchar, ClockConfigImageType image)
+{
+  AppMatrixBitmapType rest;
+  uint32_t frame;
+  uint8_t rows = BITMAP_ROWS;
+  int64_t lines;
+
+  if(ClockConfigLoadContainer(file, image)) {
+    return;
+  }
+
+  if(binary) {
+    FileCheckBinaryTerminal(file);
+    FileRead(file, image, sizeof(ClockConfigImageType));
+    if(fgetc(file) != EOF) {
+      ExitWithError("Input longer than %u frames", CLOCK_CONFIG_FRAMES);
+    }
+    return;
+  }
+
+  // Not mappable, read sequentially
+  if((lines = ClockConfigParseMapped(file, dotchar, commentchar, image)) < 0) {
+    for(lines = 0, frame = 0; (frame < CLOCK_CONFIG_FRAMES) && (rows == BITMAP_ROWS); frame++) {
+      rows = BitmapRead(file, image[frame / APP_CLOCK_CONFIG_PER_PAGES][frame % APP_CLOCK_CONFIG_PER_PAGES],
+        dotchar, commentchar);
+      lines += rows;
+    }
+    // There must be nothing left
+    if(rows == BITMAP_ROWS) {
+      lines += BitmapRead(file, rest, dotchar, commentchar);
+    }
+  }
+  if(lines != CLOCK_CONFIG_TEXT_LINES) {
+    ExitWithError("Invalid Input: %lld lines instead of %u", (long long)lines, CLOCK_CONFIG_TEXT_LINES);
+  }
+}
+
+/***********************************************************************************************************************
+ * Convert a clock configuration between text and binary format (or into a container if compact) without a device
+ * The input has to hold exactly one complete day. Clock faces generated from a template are written as binary.
+ **********************************************************************************************************************/
+void ClockConfigConvert(char *filename, bool binary, char *templateFilename, char *outFilename, char dotchar,
+  char commentchar, bool compact)
+{
+  ClockConfigImageType *image;
+  FILE *file;
+
+  if((image = malloc(sizeof(ClockConfigImageType))) == NULL) {
+    ExitWithError("Out of memory");
+  }
+
+  // Generate clock face or load input
+  if(templateFilename != NULL) {
+    GeneratorType *generator = ClockConfigLoadTemplate(templateFilename);
+    GeneratorRenderFrames(generator, (AppMatrixBitmapType *)*image, CLOCK_CONFIG_FRAMES);
+    GeneratorFree(generator);
+    binary = false;
+  }
+  else {
+    file = FileOpen(filename, false);
+    ClockConfigLoadInput(file, binary, dotchar, commentchar, *image);
+    FileClose(file);
+  }
+
+  // Write output as container or in the other format
+  file = FileOpen(strcmp(outFilename, "-") ? outFilename : NULL, true);
+  if(compact) {
+    FileCheckBinaryTerminal(file);
+    ContainerSave(file, (AppMatrixBitmapType *)*image, 0, CLOCK_CONFIG_FRAMES);
+  }
+  else if(binary) {
+    ClockConfigFormatterType formatter = {
+      .image = *image,
+      .dotchar = dotchar,
+      .commentchar = commentchar
+    };
+    uint32_t frame;
+
+    formatter.text = malloc((size_t)CLOCK_CONFIG_FRAMES * CLOCK_CONFIG_MAX_FRAME_LENGTH);
+    formatter.lengths = malloc(CLOCK_CONFIG_FRAMES * sizeof(formatter.lengths[0]));
+    if((formatter.text == NULL) || (formatter.lengths == NULL)) {
+      ExitWithError("Out of memory");
+    }
+
+    ParallelRun(CLOCK_CONFIG_FRAMES, ClockConfigFormatFrames, &formatter);
+    for(frame = 0; frame < CLOCK_CONFIG_FRAMES; frame++) {
+      FileWrite(file, formatter.text + ((size_t)frame * CLOCK_CONFIG_MAX_FRAME_LENGTH), formatter.lengths[frame]);
+    }
+
+    free(formatter.lengths);
+    free(formatter.text);
+  }
+  else {
+    FileCheckBinaryTerminal(file);
+    FileWrite(file, *image, sizeof(ClockConfigImageType));
+  }
   FileClose(file);
+
+  free(image);
 }
@@ -35,8 +35,18 @@
 #define CLOCK_CONFIG_H_
 
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "app.h"
 
-void ClockConfigRead(char *filename, bool binary, char *device, char *timestamp, char dotchar, char commentchar);
-void ClockConfigWrite(char *filename, bool binary, char *device, char dotchar, char commentchar);
+// The whole clock configuration as stored in the flash pages
+typedef AppClockMatrixBitmap ClockConfigImageType[APP_CLOCK_CONFIG_FLASH_PAGES];
+
+void ClockConfigRead(char *filename, bool binary, char *device, char *timestamp, char dotchar, char commentchar,
+  int32_t mirrorSamples, bool compact);
+void ClockConfigWrite(char *filename, bool binary, char *templateFilename, char *device, char *timestamp, char dotchar,
+  char commentchar, bool diff, char *baseFilename, bool resume, int32_t verifySamples);
+void ClockConfigConvert(char *filename, bool binary, char *templateFilename, char *outFilename, char dotchar,
+  char commentchar, bool compact);
 
 #endif // CLOCK_CONFIG_H_
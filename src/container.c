@@ -0,0 +1,335 @@
+/***********************************************************************************************************************
+ *
+ * ID100 Utility
+ * Clock Configuration Container
+ *
+ * (C) 2017 Gergely Budai
+ *
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ *
+ **********************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <endian.h>
+#include <unistd.h>
+#include "container.h"
+#include "app.h"
+#include "file.h"
+#include "hash.h"
+#include "utils.h"
+
+// Format version
+#define CONTAINER_VERSION 1
+// Initial buffer size for containers read from a stream
+#define CONTAINER_STREAM_SIZE 65536
+
+// Container file header, all numbers big endian
+// The header is followed by the dictionary of distinct frames and the index holding the dictionary entry of every
+// frame, so any frame can be looked up directly. The checksum covers dictionary and index.
+typedef struct __packed {
+  char magic[8];
+  uint8_t version;
+  uint8_t indexWidth;
+  uint16_t frameLength;
+  uint32_t firstFrame;
+  uint32_t frames;
+  uint32_t entries;
+  Hash64Type checksum;
+} ContainerHeaderType;
+
+struct ContainerStruct {
+  const uint8_t *data;
+  size_t length;
+  // Mapped file or read from a stream into memory
+  bool mapped;
+  const uint8_t *dictionary;
+  const uint8_t *index;
+  uint8_t indexWidth;
+  uint32_t firstFrame;
+  uint32_t frames;
+  uint32_t entries;
+};
+
+static const char containerMagic[8] = "ID100CFZ";
+
+/***********************************************************************************************************************
+ * Get the number of bytes per index entry needed for the given number of dictionary entries
+ **********************************************************************************************************************/
+static uint8_t ContainerGetIndexWidth(uint32_t entries)
+{
+  return (entries <= 0x100) ? 1 : ((entries <= 0x10000) ? 2 : 4);
+}
+
+/***********************************************************************************************************************
+ * Read a container from a stream (e.g. a pipe) into memory, return NULL if the stream holds no container
+ * The first bytes are given back to the stream unless they are the magic, so the input can still be read otherwise.
+ **********************************************************************************************************************/
+static uint8_t *ContainerReadStream(FILE *file, size_t *length)
+{
+  char magic[sizeof(containerMagic)];
+  size_t size = CONTAINER_STREAM_SIZE, got;
+  uint8_t *data;
+
+  // Typing into a terminal is never a container, and binary input checks for the terminal later on
+  if(isatty(fileno(file))) {
+    return NULL;
+  }
+  // isatty() sets errno for everything else
+  errno = 0;
+
+  // Up to 8 bytes of push back are supported by the C libraries in use (glibc and musl)
+  got = fread(magic, 1, sizeof(magic), file);
+  if((got < sizeof(magic)) || (memcmp(magic, containerMagic, sizeof(magic)) != 0)) {
+    while(got > 0) {
+      ungetc((unsigned char)magic[--got], file);
+    }
+    return NULL;
+  }
+
+  if((data = malloc(size)) == NULL) {
+    ExitWithError("Out of memory");
+  }
+  memcpy(data, magic, sizeof(magic));
+  *length = sizeof(magic);
+  while((got = fread(data + *length, 1, size - *length, file)) > 0) {
+    *length += got;
+    if((*length == size) && ((data = realloc(data, size *= 2)) == NULL)) {
+      ExitWithError("Out of memory");
+    }
+  }
+  if(ferror(file)) {
+    ExitWithError("Unable to read container");
+  }
+
+  return data;
+}
+
+/***********************************************************************************************************************
+ * Load a container from file, return NULL if the file holds no container
+ * Regular files are mapped, so loading is instant and frames are read on demand. Other input is read into memory.
+ **********************************************************************************************************************/
+ContainerType *ContainerLoad(FILE *file)
+{
+  const ContainerHeaderType *header;
+  ContainerType *container;
+  const uint8_t *data;
+  bool mapped = true;
+  size_t length;
+
+  if((data = FileMap(file, &length)) == NULL) {
+    if((data = ContainerReadStream(file, &length)) == NULL) {
+      return NULL;
+    }
+    mapped = false;
+  }
+  header = (const ContainerHeaderType *)data;
+  if((length < sizeof(*header)) || (memcmp(header->magic, containerMagic, sizeof(header->magic)) != 0)) {
+    if(!mapped) {
+      ExitWithError("Invalid container");
+    }
+    FileUnmap(data, length);
+    return NULL;
+  }
+
+  if((container = malloc(sizeof(*container))) == NULL) {
+    ExitWithError("Out of memory");
+  }
+  container->data = data;
+  container->length = length;
+  container->mapped = mapped;
+  container->indexWidth = header->indexWidth;
+  container->firstFrame = be32toh(header->firstFrame);
+  container->frames = be32toh(header->frames);
+  container->entries = be32toh(header->entries);
+  container->dictionary = data + sizeof(*header);
+  container->index = container->dictionary + ((size_t)container->entries * sizeof(AppMatrixBitmapType));
+
+  // Check format and contents
+  if(header->version != CONTAINER_VERSION) {
+    ExitWithError("Unsupported container version: %u", header->version);
+  }
+  if((be16toh(header->frameLength) != sizeof(AppMatrixBitmapType)) ||
+     (container->indexWidth != ContainerGetIndexWidth(container->entries)) ||
+     (length != (sizeof(*header) + ((size_t)container->entries * sizeof(AppMatrixBitmapType)) +
+                 ((size_t)container->frames * container->indexWidth)))) {
+    ExitWithError("Invalid container");
+  }
+  if(Hash64CalculateBuffer(container->dictionary, length - sizeof(*header)) != be64toh(header->checksum)) {
+    ExitWithError("Container checksum mismatch");
+  }
+
+  // Check index, so lookups can not go wrong later
+  uint32_t frame;
+  for(frame = container->firstFrame; frame < (container->firstFrame + container->frames); frame++) {
+    if(ContainerGetFrame(container, frame) == NULL) {
+      ExitWithError("Invalid container");
+    }
+  }
+
+  return container;
+}
+
+/***********************************************************************************************************************
+ * Get the number of the first frame in the container
+ **********************************************************************************************************************/
+uint32_t ContainerGetFirstFrame(ContainerType *container)
+{
+  return container->firstFrame;
+}
+
+/***********************************************************************************************************************
+ * Get the number of frames in the container
+ **********************************************************************************************************************/
+uint32_t ContainerGetFrames(ContainerType *container)
+{
+  return container->frames;
+}
+
+/***********************************************************************************************************************
+ * Get a frame by its number (second of the day), return NULL if the container does not hold it
+ **********************************************************************************************************************/
+const uint8_t *ContainerGetFrame(ContainerType *container, uint32_t frame)
+{
+  const uint8_t *index;
+  uint32_t entry;
+
+  if((frame < container->firstFrame) || (frame >= (container->firstFrame + container->frames))) {
+    return NULL;
+  }
+
+  index = container->index + ((size_t)(frame - container->firstFrame) * container->indexWidth);
+  switch(container->indexWidth) {
+    case 1: {
+      entry = index[0];
+    }
+    break;
+
+    case 2: {
+      entry = (index[0] << 8) | index[1];
+    }
+    break;
+
+    default: {
+      entry = ((uint32_t)index[0] << 24) | (index[1] << 16) | (index[2] << 8) | index[3];
+    }
+    break;
+  }
+
+  if(entry >= container->entries) {
+    return NULL;
+  }
+
+  return container->dictionary + ((size_t)entry * sizeof(AppMatrixBitmapType));
+}
+
+/***********************************************************************************************************************
+ * Free the container
+ **********************************************************************************************************************/
+void ContainerFree(ContainerType *container)
+{
+  if(container->mapped) {
+    FileUnmap(container->data, container->length);
+  }
+  else {
+    free((void *)container->data);
+  }
+  free(container);
+}
+
+/***********************************************************************************************************************
+ * Save frames as container, the first one being frame number firstFrame
+ * Identical frames are stored only once, found by a hash table over the dictionary.
+ **********************************************************************************************************************/
+void ContainerSave(FILE *file, const AppMatrixBitmapType *frames, uint32_t firstFrame, uint32_t count)
+{
+  ContainerHeaderType header;
+  uint32_t *slots, *dictionary, *entries, size, frame, numberOfEntries = 0;
+  uint8_t *index;
+  Hash64Type checksum = HASH64_INIT;
+
+  // Hash table with at least twice as many slots as frames, holding dictionary entry + 1
+  for(size = 1; size < (count * 2); size <<= 1);
+  if(((slots = calloc(size, sizeof(*slots))) == NULL) ||
+     ((dictionary = malloc(count * sizeof(*dictionary))) == NULL) ||
+     ((entries = malloc(count * sizeof(*entries))) == NULL) ||
+     ((index = malloc(count * sizeof(uint32_t))) == NULL)) {
+    ExitWithError("Out of memory");
+  }
+
+  // Build dictionary (holding the number of the first frame with the contents) and the entry of every frame
+  for(frame = 0; frame < count; frame++) {
+    uint32_t slot = Hash64CalculateBuffer(frames[frame], sizeof(AppMatrixBitmapType)) & (size - 1);
+
+    while((slots[slot] != 0) &&
+          (memcmp(frames[dictionary[slots[slot] - 1]], frames[frame], sizeof(AppMatrixBitmapType)) != 0)) {
+      slot = (slot + 1) & (size - 1);
+    }
+    if(slots[slot] == 0) {
+      dictionary[numberOfEntries++] = frame;
+      slots[slot] = numberOfEntries;
+    }
+    entries[frame] = slots[slot] - 1;
+  }
+
+  // Encode index big endian with the smallest width possible
+  uint8_t indexWidth = ContainerGetIndexWidth(numberOfEntries), *entry = index;
+  for(frame = 0; frame < count; frame++) {
+    int8_t shift;
+    for(shift = (indexWidth - 1) * 8; shift >= 0; shift -= 8) {
+      *entry++ = entries[frame] >> shift;
+    }
+  }
+
+  // Checksum over dictionary and index
+  for(frame = 0; frame < numberOfEntries; frame++) {
+    checksum = Hash64Update(checksum, frames[dictionary[frame]], sizeof(AppMatrixBitmapType));
+  }
+  checksum = Hash64Update(checksum, index, entry - index);
+
+  // Write header, dictionary and index
+  memcpy(header.magic, containerMagic, sizeof(header.magic));
+  header.version = CONTAINER_VERSION;
+  header.indexWidth = indexWidth;
+  header.frameLength = htobe16(sizeof(AppMatrixBitmapType));
+  header.firstFrame = htobe32(firstFrame);
+  header.frames = htobe32(count);
+  header.entries = htobe32(numberOfEntries);
+  header.checksum = htobe64(checksum);
+  FileWrite(file, &header, sizeof(header));
+  for(frame = 0; frame < numberOfEntries; frame++) {
+    FileWrite(file, (void *)frames[dictionary[frame]], sizeof(AppMatrixBitmapType));
+  }
+  FileWrite(file, index, entry - index);
+
+  free(index);
+  free(entries);
+  free(dictionary);
+  free(slots);
+}
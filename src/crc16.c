@@ -31,11 +31,13 @@
  *
  **********************************************************************************************************************/
 #include "crc16.h"
+// Lookup tables, generated at build time by tools/crc16_table.c
+#include "crc16_table.h"
 
 /***********************************************************************************************************************
- * Update CRC-16 for one byte
+ * Update CRC-16 for one byte, bit by bit (reference implementation)
  **********************************************************************************************************************/
-Crc16Type Crc16UpdateByte(Crc16Type crc16, uint8_t byte)
+static Crc16Type Crc16UpdateByteBitwise(Crc16Type crc16, uint8_t byte)
 {
   static const Crc16Type polynom = 0x8005;
   uint_fast8_t bit;
@@ -49,10 +51,42 @@ Crc16Type Crc16UpdateByte(Crc16Type crc16, uint8_t byte)
 }
 
 /***********************************************************************************************************************
- * Update CRC-16 for a whole buffer
+ * Update CRC-16 for one byte
  **********************************************************************************************************************/
-Crc16Type Crc16UpdateBuffer(Crc16Type crc16, const uint8_t *buffer, uint32_t length)
+Crc16Type Crc16UpdateByte(Crc16Type crc16, uint8_t byte)
+{
+  return (crc16 << 8) ^ crc16Table[0][(crc16 >> 8) ^ byte];
+}
+
+/***********************************************************************************************************************
+ * Update CRC-16 for a buffer, four bytes at a time
+ **********************************************************************************************************************/
+static Crc16Type Crc16UpdateBufferSlice4(Crc16Type crc16, const uint8_t *buffer, uint32_t length)
+{
+  for(; length >= 4; length -= 4, buffer += 4) {
+    crc16 = crc16Table[3][buffer[0] ^ (crc16 >> 8)] ^ crc16Table[2][buffer[1] ^ (crc16 & 0xFF)] ^
+            crc16Table[1][buffer[2]] ^ crc16Table[0][buffer[3]];
+  }
+
+  while(length--) {
+    crc16 = Crc16UpdateByte(crc16, *buffer++);
+  }
+
+  return crc16;
+}
+
+/***********************************************************************************************************************
+ * Update CRC-16 for a buffer, eight bytes at a time
+ **********************************************************************************************************************/
+static Crc16Type Crc16UpdateBufferSlice8(Crc16Type crc16, const uint8_t *buffer, uint32_t length)
 {
+  for(; length >= 8; length -= 8, buffer += 8) {
+    crc16 = crc16Table[7][buffer[0] ^ (crc16 >> 8)] ^ crc16Table[6][buffer[1] ^ (crc16 & 0xFF)] ^
+            crc16Table[5][buffer[2]] ^ crc16Table[4][buffer[3]] ^
+            crc16Table[3][buffer[4]] ^ crc16Table[2][buffer[5]] ^
+            crc16Table[1][buffer[6]] ^ crc16Table[0][buffer[7]];
+  }
+
   while(length--) {
     crc16 = Crc16UpdateByte(crc16, *buffer++);
   }
@@ -61,12 +95,86 @@ Crc16Type Crc16UpdateBuffer(Crc16Type crc16, const uint8_t *buffer, uint32_t len
 }
 
 /***********************************************************************************************************************
- * CRC-16 Self check
+ * Update CRC-16 for a whole buffer
+ **********************************************************************************************************************/
+Crc16Type Crc16UpdateBuffer(Crc16Type crc16, const uint8_t *buffer, uint32_t length)
+{
+  return Crc16UpdateBufferSlice8(crc16, buffer, length);
+}
+
+/***********************************************************************************************************************
+ * Update CRC-16 for a whole buffer with the requested implementation
+ **********************************************************************************************************************/
+Crc16Type Crc16UpdateBufferVariant(Crc16VariantType variant, Crc16Type crc16, const uint8_t *buffer, uint32_t length)
+{
+  switch(variant) {
+    case Crc16Bitwise: {
+      while(length--) {
+        crc16 = Crc16UpdateByteBitwise(crc16, *buffer++);
+      }
+    }
+    break;
+
+    case Crc16Table: {
+      while(length--) {
+        crc16 = Crc16UpdateByte(crc16, *buffer++);
+      }
+    }
+    break;
+
+    case Crc16Slice4: {
+      crc16 = Crc16UpdateBufferSlice4(crc16, buffer, length);
+    }
+    break;
+
+    default:
+    case Crc16Slice8: {
+      crc16 = Crc16UpdateBufferSlice8(crc16, buffer, length);
+    }
+    break;
+  }
+
+  return crc16;
+}
+
+/***********************************************************************************************************************
+ * Get the name of a CRC-16 implementation
+ **********************************************************************************************************************/
+const char *Crc16VariantName(Crc16VariantType variant)
+{
+  static const char *names[Crc16NumberOfVariants] = {
+    "bitwise",
+    "table",
+    "slice4",
+    "slice8"
+  };
+
+  return (variant < Crc16NumberOfVariants) ? names[variant] : "unknown";
+}
+
+/***********************************************************************************************************************
+ * CRC-16 Self check, returns true if any of the implementations fails
  **********************************************************************************************************************/
 bool Crc16SelfCheck(void)
 {
   static const uint8_t text[] = "The quick brown fox jumps over the lazy dog.";
   static const Crc16Type crc = 0x072B;
+  Crc16VariantType variant;
+  uint32_t split;
+
+  for(variant = 0; variant < Crc16NumberOfVariants; variant++) {
+    // Whole buffer at once
+    if(Crc16UpdateBufferVariant(variant, 0xFFFF, text, sizeof(text) - 1) != crc) {
+      return true;
+    }
+    // Split at every position, to cover the tail handling of the sliced versions
+    for(split = 0; split < sizeof(text); split++) {
+      Crc16Type partial = Crc16UpdateBufferVariant(variant, 0xFFFF, text, split);
+      if(Crc16UpdateBufferVariant(variant, partial, &text[split], sizeof(text) - 1 - split) != crc) {
+        return true;
+      }
+    }
+  }
 
-  return(Crc16UpdateBuffer(0xFFFF, text, sizeof(text) - 1) != crc);
+  return false;
 }
@@ -38,8 +38,19 @@
 
 typedef uint16_t Crc16Type;
 
+// CRC-16 implementations, all giving the same result
+typedef enum {
+  Crc16Bitwise,
+  Crc16Table,
+  Crc16Slice4,
+  Crc16Slice8,
+  Crc16NumberOfVariants
+} Crc16VariantType;
+
 Crc16Type Crc16UpdateByte(Crc16Type crc16, uint8_t byte);
 Crc16Type Crc16UpdateBuffer(Crc16Type crc16, const uint8_t *buffer, uint32_t length);
+Crc16Type Crc16UpdateBufferVariant(Crc16VariantType variant, Crc16Type crc16, const uint8_t *buffer, uint32_t length);
+const char *Crc16VariantName(Crc16VariantType variant);
 bool Crc16SelfCheck(void);
 
 #define Crc16CalculateBuffer(buffer, length) Crc16UpdateBuffer(0xFFFF, buffer, length)
@@ -0,0 +1,412 @@
+/***********************************************************************************************************************
+ *
+ * ID100 Utility
+ * Device Daemon
+ *
+ * (C) 2017 Gergely Budai
+ *
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ *
+ **********************************************************************************************************************/
+// Credentials of socket peers
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "daemon.h"
+#include "app.h"
+#include "link.h"
+#include "phy.h"
+#include "utils.h"
+
+// Number of clients served at once, more are turned away
+#define DAEMON_MAX_CLIENTS 32
+// Receive buffer of a client, a request frame is at most LINK_MAX_FRAME_LENGTH(LINK_MAX_BUFFER_LENGTH) long
+#define DAEMON_RX_BUFFER_SIZE 1024
+
+// Connection of one client, it sends one request frame and waits for the answer
+typedef struct {
+  int fd;
+  // Data received from the client, not yet decoded
+  uint8_t rxBuffer[DAEMON_RX_BUFFER_SIZE];
+  uint16_t rxHead, rxTail;
+  LinkDecoderType decoder;
+  uint8_t request[LINK_MAX_BUFFER_LENGTH];
+  // Complete request waiting to be served
+  bool pending;
+  // Answered while serving someone else, data received after the request is decoded from the main loop
+  bool resume;
+  // Process on the other side and its preview frames: submitted and replaced by newer ones before being sent
+  pid_t pid;
+  uint32_t frames;
+  uint32_t dropped;
+} DaemonClientType;
+
+static DaemonClientType clients[DAEMON_MAX_CLIENTS];
+// Client whose preview frame is the next one to send, newer frames from anyone replace it
+static DaemonClientType *previewSource = NULL;
+static volatile sig_atomic_t quit = false;
+static volatile sig_atomic_t printStats = false;
+
+/***********************************************************************************************************************
+ * Statistics on SIGUSR1, stop serving on anything else
+ **********************************************************************************************************************/
+static void DaemonSignal(int signal)
+{
+  if(signal == SIGUSR1) {
+    printStats = true;
+  }
+  else {
+    quit = true;
+  }
+}
+
+/***********************************************************************************************************************
+ * Print the preview frame statistics of a client
+ **********************************************************************************************************************/
+static void DaemonPrintStats(DaemonClientType *client)
+{
+  if(client->frames) {
+    fprintf(stderr, "Client %d: %u preview frames, %u replaced by newer ones\n", (int)client->pid, client->frames,
+      client->dropped);
+  }
+}
+
+/***********************************************************************************************************************
+ * Close the connection to a client, a preview frame of it is not sent any more
+ **********************************************************************************************************************/
+static void DaemonClose(DaemonClientType *client)
+{
+  if(client->dropped) {
+    DaemonPrintStats(client);
+  }
+  if(previewSource == client) {
+    previewSource = NULL;
+  }
+  close(client->fd);
+  client->fd = -1;
+  client->pending = false;
+  client->resume = false;
+}
+
+/***********************************************************************************************************************
+ * Send an answer frame to a client, return false if the client is gone
+ **********************************************************************************************************************/
+static bool DaemonAnswer(DaemonClientType *client, uint8_t command, const void *answer, uint16_t length)
+{
+  static uint8_t frame[LINK_MAX_FRAME_LENGTH(LINK_MAX_BUFFER_LENGTH)];
+  uint16_t frameLength = LinkEncodeFrame(frame, command, answer, length);
+
+  if(send(client->fd, frame, frameLength, MSG_NOSIGNAL) != frameLength) {
+    DaemonClose(client);
+    return false;
+  }
+
+  return true;
+}
+
+/***********************************************************************************************************************
+ * Accept a new client if there is a free slot
+ **********************************************************************************************************************/
+static void DaemonAccept(int listenFd)
+{
+  struct ucred credentials;
+  socklen_t length = sizeof(credentials);
+  DaemonClientType *client;
+  int fd;
+  uint8_t i;
+
+  if((fd = accept(listenFd, NULL, NULL)) < 0) {
+    return;
+  }
+
+  for(i = 0; (i < DAEMON_MAX_CLIENTS) && (clients[i].fd >= 0); i++);
+  if((i >= DAEMON_MAX_CLIENTS) || (fcntl(fd, F_SETFL, O_NONBLOCK) != 0)) {
+    close(fd);
+    return;
+  }
+
+  client = &clients[i];
+  client->fd = fd;
+  client->rxHead = client->rxTail = 0;
+  client->pending = client->resume = false;
+  client->pid = getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) ? -1 : credentials.pid;
+  client->frames = client->dropped = 0;
+  LinkDecoderInit(&client->decoder, client->request, sizeof(client->request));
+}
+
+/***********************************************************************************************************************
+ * Get ready for the next request of a client after the last one was answered
+ **********************************************************************************************************************/
+static void DaemonReset(DaemonClientType *client)
+{
+  client->pending = false;
+  LinkDecoderInit(&client->decoder, client->request, sizeof(client->request));
+}
+
+/***********************************************************************************************************************
+ * Make a preview frame the next one to send. The frame it replaces is answered at once without being sent, so
+ * producers are never held up by stale frames and the display shows the newest frame as soon as the line is free.
+ * Whatever its producer sent afterwards is decoded later from the main loop, decoding it here could queue a frame and
+ * replace this one again, recursing between producers.
+ **********************************************************************************************************************/
+static void DaemonQueuePreview(DaemonClientType *client)
+{
+  DaemonClientType *replaced = previewSource;
+
+  previewSource = client;
+  client->frames++;
+
+  if(replaced != NULL) {
+    replaced->dropped++;
+    if(DaemonAnswer(replaced, 'D', NULL, 0)) {
+      DaemonReset(replaced);
+      replaced->resume = true;
+    }
+  }
+}
+
+/***********************************************************************************************************************
+ * Decode received data until a complete request is there
+ **********************************************************************************************************************/
+static void DaemonDecode(DaemonClientType *client)
+{
+  LinkDecoderEventType event;
+  uint16_t consumed;
+
+  while(!client->pending && (client->rxHead < client->rxTail)) {
+    event = LinkDecoderPush(&client->decoder, &client->rxBuffer[client->rxHead], client->rxTail - client->rxHead,
+      &consumed);
+    client->rxHead += consumed;
+    // A local socket does not break frames, so the client is confused and would only wait for its timeout
+    if((event != LinkDecoderMore) && (event != LinkDecoderFrame)) {
+      fprintf(stderr, "Client %d: broken request, closing connection\n", (int)client->pid);
+      DaemonClose(client);
+      return;
+    }
+    client->pending = (event == LinkDecoderFrame);
+  }
+
+  if(client->pending && (client->decoder.command == 'D') && (client->decoder.length == sizeof(AppMatrixBitmapType))) {
+    DaemonQueuePreview(client);
+  }
+}
+
+/***********************************************************************************************************************
+ * Get ready for the next request of a client and go on with anything it sent after the last one
+ **********************************************************************************************************************/
+static void DaemonNext(DaemonClientType *client)
+{
+  DaemonReset(client);
+  DaemonDecode(client);
+}
+
+/***********************************************************************************************************************
+ * Receive data from a client
+ **********************************************************************************************************************/
+static void DaemonReceive(DaemonClientType *client)
+{
+  ssize_t received;
+
+  if(client->rxHead == client->rxTail) {
+    client->rxHead = client->rxTail = 0;
+  }
+
+  received = read(client->fd, &client->rxBuffer[client->rxTail], sizeof(client->rxBuffer) - client->rxTail);
+  if((received == 0) || ((received < 0) && (errno != EAGAIN) && (errno != EINTR))) {
+    DaemonClose(client);
+    return;
+  }
+  if(received > 0) {
+    client->rxTail += received;
+    DaemonDecode(client);
+  }
+}
+
+/***********************************************************************************************************************
+ * Pass the request of a client to the device and send the answer back
+ **********************************************************************************************************************/
+static void DaemonServe(AppType *app, DaemonClientType *client)
+{
+  static uint8_t answer[LINK_MAX_BUFFER_LENGTH];
+  LinkDecoderType *decoder = &client->decoder;
+  AppStatusType status;
+  uint16_t answerLength;
+
+  // Preview frame is on its way, anything newer waits for the next one
+  if(previewSource == client) {
+    previewSource = NULL;
+  }
+
+  status = AppRelay(app, decoder->command, client->request, decoder->length, answer, sizeof(answer), &answerLength);
+  // Without the device there is nothing left to serve
+  if(status == AppIoError) {
+    ExitOnAppError(app, status);
+  }
+
+  if(status == AppOk) {
+    if(!DaemonAnswer(client, decoder->command, answer, answerLength)) {
+      return;
+    }
+  }
+  // The client does not send the request again, so tell it what went wrong instead of letting it wait
+  else {
+    fprintf(stderr, "%s\n", AppGetError(app));
+    answer[0] = status;
+    answerLength = 1 + snprintf((char *)&answer[1], sizeof(answer) - 1, "%s", AppGetError(app));
+    if(!DaemonAnswer(client, APP_DAEMON_ERROR, answer, answerLength)) {
+      return;
+    }
+  }
+
+  DaemonNext(client);
+}
+
+/***********************************************************************************************************************
+ * Keep the device open and pass requests of other id100 invocations through a socket to it until terminated
+ * Clients are served round robin, one request each per round, so a long transfer does not block short commands.
+ **********************************************************************************************************************/
+void DaemonRun(char *device)
+{
+  struct pollfd pollFds[DAEMON_MAX_CLIENTS + 1];
+  DaemonClientType *polled[DAEMON_MAX_CLIENTS + 1];
+  struct sockaddr_un address;
+  struct sigaction action = { .sa_handler = DaemonSignal };
+  uint8_t i, next = 0, count;
+  bool pending = false, resumed;
+  int listenFd;
+
+  if(!PhyGetSocketPath(&address, device, true)) {
+    ExitWithError("No cache directory for the socket of device: %s", device);
+  }
+
+  // A socket answering means another daemon owns the device, otherwise it is left over
+  if((listenFd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+    ExitWithError("Could not create socket");
+  }
+  if(connect(listenFd, (struct sockaddr *)&address, sizeof(address)) == 0) {
+    errno = 0;
+    ExitWithError("Daemon already running for device: %s", device);
+  }
+  close(listenFd);
+  unlink(address.sun_path);
+
+  AppType *app = OpenDevice(device);
+
+  if(((listenFd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) ||
+     (bind(listenFd, (struct sockaddr *)&address, sizeof(address)) != 0) ||
+     (listen(listenFd, DAEMON_MAX_CLIENTS) != 0)) {
+    ExitWithError("Could not listen on socket: %s", address.sun_path);
+  }
+
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  sigaction(SIGUSR1, &action, NULL);
+  for(i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+    clients[i].fd = -1;
+  }
+  fprintf(stderr, "Serving %s on %s\n", device, address.sun_path);
+
+  while(!quit) {
+    // Go on decoding for producers whose preview frames were replaced, one request at a time, which may replace others
+    do {
+      resumed = false;
+      for(i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+        if(clients[i].resume) {
+          clients[i].resume = false;
+          DaemonDecode(&clients[i]);
+          pending |= clients[i].pending;
+          resumed = true;
+        }
+      }
+    } while(resumed);
+
+    // Listen for new clients and requests of clients not waiting for an answer
+    pollFds[0].fd = listenFd;
+    pollFds[0].events = POLLIN;
+    for(i = 0, count = 1; i < DAEMON_MAX_CLIENTS; i++) {
+      if((clients[i].fd >= 0) && !clients[i].pending) {
+        pollFds[count].fd = clients[i].fd;
+        pollFds[count].events = POLLIN;
+        polled[count++] = &clients[i];
+      }
+    }
+
+    if(printStats) {
+      printStats = false;
+      for(i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+        if(clients[i].fd >= 0) {
+          DaemonPrintStats(&clients[i]);
+        }
+      }
+    }
+
+    if(poll(pollFds, count, pending ? 0 : -1) < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      ExitWithError("Could not wait for clients");
+    }
+
+    if(pollFds[0].revents & POLLIN) {
+      DaemonAccept(listenFd);
+    }
+    for(i = 1; i < count; i++) {
+      if(pollFds[i].revents) {
+        DaemonReceive(polled[i]);
+      }
+    }
+
+    // Serve one request of every waiting client, starting with a different client every round
+    pending = false;
+    for(i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+      DaemonClientType *client = &clients[(next + i) % DAEMON_MAX_CLIENTS];
+      if((client->fd >= 0) && client->pending) {
+        DaemonServe(app, client);
+        pending |= client->pending;
+      }
+    }
+    next = (next + 1) % DAEMON_MAX_CLIENTS;
+  }
+
+  for(i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+    if(clients[i].fd >= 0) {
+      DaemonClose(&clients[i]);
+    }
+  }
+  close(listenFd);
+  unlink(address.sun_path);
+  CloseDevice(app);
+}
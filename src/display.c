@@ -35,7 +35,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
-#include <unistd.h>
+#include <errno.h>
+#include <time.h>
 #include "display.h"
 #include "app.h"
 #include "file.h"
@@ -47,15 +48,39 @@
  **********************************************************************************************************************/
 void DisplaySetNormalMode(char *device)
 {
-  AppInit(device);
-  AppSetNormalMode();
-  AppCleanup();
+  AppType *app = OpenDevice(device);
+  ExitOnAppError(app, AppSetNormalMode(app));
+  CloseDevice(app);
 }
 
 /***********************************************************************************************************************
- * Show user content
+ * Get a monotonic time stamp in nanoseconds
  **********************************************************************************************************************/
-void DisplayShowContent(char *filename, bool binary, char *device, char dotchar, char commentchar, uint32_t delay, uint32_t repeat)
+static uint64_t DisplayGetTime(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec * 1000000000ULL) + now.tv_nsec;
+}
+
+/***********************************************************************************************************************
+ * Sleep until the given monotonic time stamp in nanoseconds. Waiting for absolute deadlines instead of sleeping a
+ * delay after every frame keeps parse and transmission times from adding up.
+ **********************************************************************************************************************/
+static void DisplaySleepUntil(uint64_t deadline)
+{
+  struct timespec time = { .tv_sec = deadline / 1000000000ULL, .tv_nsec = deadline % 1000000000ULL };
+
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, NULL) == EINTR);
+}
+
+/***********************************************************************************************************************
+ * Show user content, a frame every delay milliseconds. Frames that could not be sent on their deadline count as late,
+ * with dropLate frames already a whole period late are skipped. Timing statistics go to stderr if showStats is set.
+ **********************************************************************************************************************/
+void DisplayShowContent(char *filename, bool binary, char *device, char dotchar, char commentchar, uint32_t delay,
+                        uint32_t repeat, bool dropLate, bool showStats)
 {
   // Open file
   FILE *file = FileOpen(filename, false);
@@ -65,15 +90,19 @@ void DisplayShowContent(char *filename, bool binary, char *device, char dotchar,
     FileCheckBinaryTerminal(file);
   }
 
-  // Make delay microseconds
-  delay *=1000;
+  // Make delay nanoseconds
+  uint64_t period = delay * 1000000ULL;
 
   // Init device
-  AppInit(device);
+  AppType *app = OpenDevice(device);
 
   AppMatrixBitmapType bitmap;
   bool once = true;
   uint8_t size;
+  // Frame timing
+  uint64_t startTime = DisplayGetTime(), deadline = startTime;
+  uint64_t now, lateness, latenessSum = 0, latenessMax = 0;
+  uint32_t sent = 0, late = 0, dropped = 0;
   while(repeat--) {
     // Read all frames
     for(;;) {
@@ -92,19 +121,50 @@ void DisplayShowContent(char *filename, bool binary, char *device, char dotchar,
         ExitWithError("Invalid bitmap size: %u", size);
       }
 
+      // Wait for the deadline of the frame or skip it if the next one is already due, the first frame sets the pace
+      now = DisplayGetTime();
+      if(once) {
+        startTime = deadline = now;
+      }
+      else if(now < deadline) {
+        DisplaySleepUntil(deadline);
+        now = DisplayGetTime();
+      }
+      else if(dropLate && period && ((now - deadline) >= period)) {
+        dropped++;
+        deadline += period;
+        continue;
+      }
+      else if(period && (now > deadline)) {
+        late++;
+      }
+      lateness = (period && (now > deadline)) ? (now - deadline) : 0;
+      latenessSum += lateness;
+      latenessMax = (lateness > latenessMax) ? lateness : latenessMax;
+
       // Transmit frame
-      AppSetPreviewMatrix(bitmap);
+      ExitOnAppError(app, AppSetPreviewMatrix(app, bitmap));
       // We set the preview mode after the first frame to avoid flicker
       if(once) {
-        AppSetPreviewMode();
+        ExitOnAppError(app, AppSetPreviewMode(app));
         once = false;
       }
-      usleep(delay);
+      sent++;
+      deadline += period;
     }
     rewind(file);
   }
+  // Show the last frame for its period too
+  DisplaySleepUntil(deadline);
+
+  if(showStats) {
+    double seconds = (DisplayGetTime() - startTime) / 1e9;
+    fprintf(stderr, "Show: %u frames in %.2f s, %.2f fps, jitter %.1f ms (max %.1f ms), %u late, %u dropped\n",
+      sent, seconds, (seconds > 0) ? (sent / seconds) : 0, sent ? (latenessSum / 1e6 / sent) : 0,
+      latenessMax / 1e6, late, dropped);
+  }
 
   // Cleanup
-  AppCleanup();
+  CloseDevice(app);
   FileClose(file);
 }
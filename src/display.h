@@ -35,8 +35,10 @@
 #define DISPLAY_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
 void DisplaySetNormalMode(char *device);
-void DisplayShowContent(char *filename, bool binary, char *device, char dotchar, char commentchar, uint32_t delay, uint32_t repeat);
+void DisplayShowContent(char *filename, bool binary, char *device, char dotchar, char commentchar, uint32_t delay,
+                        uint32_t repeat, bool dropLate, bool showStats);
 
 #endif // DISPLAY_H_
@@ -31,7 +31,12 @@
  * For more information, please refer to <http://unlicense.org/>
  *
  **********************************************************************************************************************/
+#include <stdlib.h>
+#include <errno.h>
 #include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <limits.h>
 #include "file.h"
 #include "utils.h"
 
@@ -98,4 +103,106 @@ void FileCheckBinaryTerminal(FILE *file)
   if(isatty(fileno(file))) {
     ExitWithError("Won't use terminal for binary data");
   }
+  // isatty() sets errno for everything else
+  errno = 0;
+}
+
+/***********************************************************************************************************************
+ * Create a directory if it does not exist yet, return false if it can not be created
+ **********************************************************************************************************************/
+static bool FileMakeDirectory(const char *path)
+{
+  struct stat status;
+
+  if(stat(path, &status) == 0) {
+    return S_ISDIR(status.st_mode);
+  }
+  if(mkdir(path, 0755) == 0) {
+    return true;
+  }
+
+  // Created by someone else meanwhile, fine as long as it is a directory
+  return (errno == EEXIST) && (stat(path, &status) == 0) && S_ISDIR(status.st_mode);
+}
+
+/***********************************************************************************************************************
+ * Get the path of a file in the cache directory ($XDG_CACHE_HOME/id100 or ~/.cache/id100), create directory if needed
+ * and asked for. Returns false if there is no usable cache directory.
+ **********************************************************************************************************************/
+bool FileGetCachePath(char *path, size_t size, const char *name, bool create)
+{
+  char *base = getenv("XDG_CACHE_HOME");
+  size_t length;
+
+  // Build and optionally create cache directory
+  if((base != NULL) && (base[0] != '\0')) {
+    length = snprintf(path, size, "%s", base);
+  }
+  else if((base = getenv("HOME")) != NULL) {
+    length = snprintf(path, size, "%s/.cache", base);
+  }
+  else {
+    return false;
+  }
+
+  if((length >= size) || (create && !FileMakeDirectory(path))) {
+    return false;
+  }
+  length += snprintf(path + length, size - length, "/id100");
+  if((length >= size) || (create && !FileMakeDirectory(path))) {
+    return false;
+  }
+  length += snprintf(path + length, size - length, "/%s", name);
+
+  return length < size;
+}
+
+/***********************************************************************************************************************
+ * Get the path of a file belonging to a device in the cache directory, named after the device path plus suffix
+ * Returns false if there is no usable cache directory.
+ **********************************************************************************************************************/
+bool FileGetDeviceCachePath(char *path, size_t size, const char *device, const char *suffix, bool create)
+{
+  char name[NAME_MAX - 8];
+  size_t i;
+
+  // Make a file name out of the device path
+  for(i = 0; device[i] && (i < (sizeof(name) - 1)); i++) {
+    name[i] = (device[i] == '/') ? '_' : device[i];
+  }
+  snprintf(name + i, sizeof(name) - i, "%s", suffix);
+  return FileGetCachePath(path, size, name, create);
+}
+
+/***********************************************************************************************************************
+ * Map a whole regular file into memory, returns NULL if the file can not be mapped (e.g. stdin is a pipe)
+ **********************************************************************************************************************/
+const void *FileMap(FILE *file, size_t *length)
+{
+  struct stat status;
+  void *data;
+
+  if((fstat(fileno(file), &status) != 0) || !S_ISREG(status.st_mode) || (status.st_size == 0)) {
+    errno = 0;
+    return NULL;
+  }
+
+  data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+  if(data == MAP_FAILED) {
+    errno = 0;
+    return NULL;
+  }
+
+  *length = status.st_size;
+  return data;
+}
+
+/***********************************************************************************************************************
+ * Unmap a file mapped by FileMap
+ **********************************************************************************************************************/
+void FileUnmap(const void *data, size_t length)
+{
+  if(munmap((void *)data, length) != 0) {
+    ExitWithError("Unable to unmap file");
+  }
 }
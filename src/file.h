@@ -42,5 +42,9 @@ void FileClose(FILE *file);
 void FileWrite(FILE *file, void *buffer, size_t length);
 void FileRead(FILE *file, void *buffer, size_t length);
 void FileCheckBinaryTerminal(FILE *file);
+bool FileGetCachePath(char *path, size_t size, const char *name, bool create);
+bool FileGetDeviceCachePath(char *path, size_t size, const char *device, const char *suffix, bool create);
+const void *FileMap(FILE *file, size_t *length);
+void FileUnmap(const void *data, size_t length);
 
 #endif // FILE_H_
@@ -0,0 +1,254 @@
+/***********************************************************************************************************************
+ *
+ * ID100 Utility
+ * Clock Face Generator
+ *
+ * (C) 2017 Gergely Budai
+ *
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ *
+ **********************************************************************************************************************/
+/***********************************************************************************************************************
+ * A clock face template is a text file with one element per line, '#' starts a comment:
+ *   text row col format      Text, format may hold %H (hour), %I (hour 1-12), %M (minute), %S (second) and %%
+ *   bar row col length unit  Horizontal bar filled according to the elapsed part of the minute (s), hour (m) or
+ *                            day (h)
+ *   blink row col            Dot shown at even seconds
+ *   dot row col              Dot always shown
+ **********************************************************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "generator.h"
+#include "bitmap.h"
+#include "char.h"
+#include "parallel.h"
+#include "utils.h"
+
+#define GENERATOR_MAX_ELEMENTS 64
+#define GENERATOR_MAX_FORMAT   16
+#define GENERATOR_MAX_LINE     256
+
+typedef enum {
+  GeneratorText,
+  GeneratorBar,
+  GeneratorBlink,
+  GeneratorDot
+} GeneratorElementKindType;
+
+typedef struct {
+  GeneratorElementKindType kind;
+  uint8_t row;
+  uint8_t column;
+  // Length and range of a bar in seconds
+  uint8_t length;
+  uint32_t range;
+  char format[GENERATOR_MAX_FORMAT];
+} GeneratorElementType;
+
+struct GeneratorStruct {
+  GeneratorElementType elements[GENERATOR_MAX_ELEMENTS];
+  uint8_t numberOfElements;
+};
+
+// Frames rendered by one worker
+typedef struct {
+  GeneratorType *generator;
+  AppMatrixBitmapType *frames;
+} GeneratorWorkType;
+
+/***********************************************************************************************************************
+ * Load a clock face template
+ **********************************************************************************************************************/
+GeneratorType *GeneratorLoad(FILE *file)
+{
+  GeneratorType *generator;
+  char line[GENERATOR_MAX_LINE];
+  uint32_t lineNumber = 0;
+
+  if((generator = calloc(1, sizeof(*generator))) == NULL) {
+    ExitWithError("Out of memory");
+  }
+
+  while(fgets(line, sizeof(line), file) != NULL) {
+    GeneratorElementType *element = &generator->elements[generator->numberOfElements];
+    char kind[8], unit;
+    unsigned int row, column, length;
+    int fields;
+
+    lineNumber++;
+    line[strcspn(line, "#\r\n")] = '\0';
+    if((fields = sscanf(line, "%7s %u %u", kind, &row, &column)) <= 0) {
+      continue;
+    }
+    if((fields != 3) || (row >= BITMAP_ROWS) || (column >= BITMAP_COLS)) {
+      ExitWithError("Bad template line %u", lineNumber);
+    }
+    if(generator->numberOfElements >= GENERATOR_MAX_ELEMENTS) {
+      ExitWithError("Too many template elements");
+    }
+    element->row = row;
+    element->column = column;
+
+    if(strcmp(kind, "text") == 0) {
+      element->kind = GeneratorText;
+      if(sscanf(line, "%*s %*u %*u %15s", element->format) != 1) {
+        ExitWithError("Bad template line %u", lineNumber);
+      }
+    }
+    else if(strcmp(kind, "bar") == 0) {
+      element->kind = GeneratorBar;
+      if((sscanf(line, "%*s %*u %*u %u %c", &length, &unit) != 2) || ((column + length) > BITMAP_COLS)) {
+        ExitWithError("Bad template line %u", lineNumber);
+      }
+      element->length = length;
+      switch(unit) {
+        case 's': element->range = 60; break;
+        case 'm': element->range = 60 * 60; break;
+        case 'h': element->range = 24 * 60 * 60; break;
+        default: ExitWithError("Bad bar unit in template line %u", lineNumber);
+      }
+    }
+    else if(strcmp(kind, "blink") == 0) {
+      element->kind = GeneratorBlink;
+    }
+    else if(strcmp(kind, "dot") == 0) {
+      element->kind = GeneratorDot;
+    }
+    else {
+      ExitWithError("Unknown template element '%s' in line %u", kind, lineNumber);
+    }
+
+    generator->numberOfElements++;
+  }
+
+  return generator;
+}
+
+/***********************************************************************************************************************
+ * Free a clock face template
+ **********************************************************************************************************************/
+void GeneratorFree(GeneratorType *generator)
+{
+  free(generator);
+}
+
+/***********************************************************************************************************************
+ * Expand the time fields of a text element
+ **********************************************************************************************************************/
+static void GeneratorFormatText(const char *format, uint32_t second, char *text)
+{
+  uint8_t hour = second / (60 * 60), minute = (second / 60) % 60, value;
+  char *end = text + GENERATOR_MAX_FORMAT - 1;
+
+  second %= 60;
+  for(; *format && (text < end); format++) {
+    if(*format != '%') {
+      *text++ = *format;
+      continue;
+    }
+    switch(*++format) {
+      case 'H': value = hour; break;
+      case 'I': value = ((hour + 11) % 12) + 1; break;
+      case 'M': value = minute; break;
+      case 'S': value = second; break;
+      case '%': *text++ = '%'; continue;
+      default: format--; *text++ = '%'; continue;
+    }
+    if((text + 1) < end) {
+      *text++ = '0' + (value / 10);
+      *text++ = '0' + (value % 10);
+    }
+  }
+  *text = '\0';
+}
+
+/***********************************************************************************************************************
+ * Render the frame of the given second of the day
+ **********************************************************************************************************************/
+void GeneratorRender(GeneratorType *generator, uint32_t second, AppMatrixBitmapType bitmap)
+{
+  uint8_t idx;
+
+  memset(bitmap, 0, sizeof(AppMatrixBitmapType));
+
+  for(idx = 0; idx < generator->numberOfElements; idx++) {
+    GeneratorElementType *element = &generator->elements[idx];
+
+    switch(element->kind) {
+      case GeneratorText: {
+        char text[GENERATOR_MAX_FORMAT];
+        GeneratorFormatText(element->format, second, text);
+        CharPutText(bitmap, text, element->row, element->column);
+      }
+      break;
+
+      case GeneratorBar: {
+        uint8_t filled = ((second % element->range) * element->length) / element->range, column;
+        for(column = 0; column < filled; column++) {
+          BitmapSetDot(bitmap, BitmapDotSet, element->row, element->column + column);
+        }
+      }
+      break;
+
+      case GeneratorBlink: {
+        if((second % 2) == 0) {
+          BitmapSetDot(bitmap, BitmapDotSet, element->row, element->column);
+        }
+      }
+      break;
+
+      case GeneratorDot: {
+        BitmapSetDot(bitmap, BitmapDotSet, element->row, element->column);
+      }
+      break;
+    }
+  }
+}
+
+/***********************************************************************************************************************
+ * Worker: render a range of frames
+ **********************************************************************************************************************/
+static void GeneratorRenderRange(void *context, uint32_t start, uint32_t end)
+{
+  GeneratorWorkType *work = context;
+
+  for(; start < end; start++) {
+    GeneratorRender(work->generator, start, work->frames[start]);
+  }
+}
+
+/***********************************************************************************************************************
+ * Render the frames of the first count seconds of the day on all processors
+ **********************************************************************************************************************/
+void GeneratorRenderFrames(GeneratorType *generator, AppMatrixBitmapType *frames, uint32_t count)
+{
+  GeneratorWorkType work = {
+    .generator = generator,
+    .frames = frames
+  };
+
+  ParallelRun(count, GeneratorRenderRange, &work);
+}
@@ -0,0 +1,48 @@
+/***********************************************************************************************************************
+ *
+ * ID100 Utility
+ * Clock Face Generator
+ *
+ * (C) 2017 Gergely Budai
+ *
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ *
+ **********************************************************************************************************************/
+#ifndef GENERATOR_H_
+#define GENERATOR_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "app.h"
+
+typedef struct GeneratorStruct GeneratorType;
+
+GeneratorType *GeneratorLoad(FILE *file);
+void GeneratorFree(GeneratorType *generator);
+void GeneratorRender(GeneratorType *generator, uint32_t second, AppMatrixBitmapType bitmap);
+void GeneratorRenderFrames(GeneratorType *generator, AppMatrixBitmapType *frames, uint32_t count);
+
+#endif // GENERATOR_H_
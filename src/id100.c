@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "app.h"
@@ -44,6 +45,8 @@
 #include "char.h"
 #include "misc.h"
 #include "intensity.h"
+#include "progress.h"
+#include "daemon.h"
 
 // Git hash
 #ifdef GIT_HASH
@@ -76,10 +79,34 @@ int main(int numberOfArguments, char *arguments[])
   uint32_t delay = 0;
   // Repeat frames so many times
   uint32_t repeat = 1;
+  // Skip frames instead of sending them late
+  bool dropLate = false;
   // Overlay options
   char *overlay = NULL;
   // Intensity
   char *intensity = NULL;
+  // Only rewrite changed sectors
+  bool diff = false;
+  // Image of the actual device contents for diff mode
+  char *baseFilename = NULL;
+  // Resume an interrupted upload
+  bool resume = false;
+  // Pages to check when reading from the local mirror, negative if mirror is not used
+  int32_t mirrorSamples = -1;
+  // Pages per sector to read back after writing (0: all), negative if not verifying
+  int32_t verifySamples = -1;
+  // Output file of the offline conversion
+  char *outFilename = NULL;
+  // Write clock configuration as container
+  bool compact = false;
+  // Show progress of long device operations
+  bool progress = false;
+  // File to append the summary of long device operations to
+  char *summaryFilename = NULL;
+  // Retries of a command after a recoverable transmission error
+  int retries = APP_DEFAULT_RETRIES;
+  // Clock face template
+  char *templateFilename = NULL;
 
   // This tells us what to do
   enum {
@@ -93,13 +120,27 @@ int main(int numberOfArguments, char *arguments[])
     OverlayText,
     ShowFirmwareVersion,
     ShowIntensity,
-    SetIntensity
+    SetIntensity,
+    ConvertClockConfig,
+    RunDaemon
   } whatToDo = DoNoting;
 
+  // Long aliases of options
+  static const struct option longOptions[] = {
+    { "resume",    no_argument,       NULL, 'R' },
+    { "verify",    optional_argument, NULL, 'v' },
+    { "progress",  no_argument,       NULL, 'P' },
+    { "summary",   required_argument, NULL, 'Y' },
+    { "retries",   required_argument, NULL, 'n' },
+    { "daemon",    no_argument,       NULL, 'L' },
+    { "drop-late", no_argument,       NULL, 'k' },
+    { NULL,        0,                 NULL, 0   }
+  };
+
   int option;
   // Check for options
   opterr = 0;
-  while((option = getopt(numberOfArguments, arguments, "cCd:D:f:F:gGiI:m:o:r:sSt:Vw:")) != -1) {
+  while((option = getopt_long(numberOfArguments, arguments, "B:cCd:D:f:F:gGiI:kl:Lm:n:o:r:RsSt:T:Puv::Vw:x:Y:z", longOptions, NULL)) != -1) {
     switch(option) {
       case 'd' : {
         device = optarg;
@@ -133,6 +174,37 @@ int main(int numberOfArguments, char *arguments[])
       }
       break;
 
+      case 'T' : {
+        templateFilename = optarg;
+      }
+      break;
+
+      case 'u' : {
+        diff = true;
+      }
+      break;
+
+      case 'l' : {
+        mirrorSamples = atoi(optarg);
+      }
+      break;
+
+      case 'R' : {
+        resume = true;
+      }
+      break;
+
+      case 'v' : {
+        verifySamples = (optarg != NULL) ? atoi(optarg) : 0;
+      }
+      break;
+
+      case 'B' : {
+        baseFilename = optarg;
+        diff = true;
+      }
+      break;
+
       case 'r' : {
         repeat = atoi(optarg);
       }
@@ -143,6 +215,11 @@ int main(int numberOfArguments, char *arguments[])
       }
       break;
 
+      case 'k' : {
+        dropLate = true;
+      }
+      break;
+
       case 'V' : {
         whatToDo = ShowFirmwareVersion;
       }
@@ -189,6 +266,40 @@ int main(int numberOfArguments, char *arguments[])
       }
       break;
 
+      case 'x' : {
+        outFilename = optarg;
+        whatToDo = ConvertClockConfig;
+      }
+      break;
+
+      case 'P' : {
+        progress = true;
+      }
+      break;
+
+      case 'Y' : {
+        summaryFilename = optarg;
+      }
+      break;
+
+      case 'n' : {
+        retries = atoi(optarg);
+        if((retries < 0) || (retries > UINT8_MAX)) {
+          ExitWithError("Invalid number of retries: %s", optarg);
+        }
+      }
+      break;
+
+      case 'z' : {
+        compact = true;
+      }
+      break;
+
+      case 'L' : {
+        whatToDo = RunDaemon;
+      }
+      break;
+
       case 'o': {
         overlay = optarg;
         whatToDo = OverlayText;
@@ -206,21 +317,29 @@ int main(int numberOfArguments, char *arguments[])
     }
   }
   ExitGetOpt:
+  ProgressSetup(progress, summaryFilename);
+  AppSetDefaultRetries(retries);
 
   // Decide what to do
   switch(whatToDo) {
     case ReadClockConfig: {
-      ClockConfigRead(filename, binary, device, timestamp, dotchar, commentchar);
+      ClockConfigRead(filename, binary, device, timestamp, dotchar, commentchar, mirrorSamples, compact);
     }
     break;
 
     case WriteClockConfig: {
-      ClockConfigWrite(filename, binary, device, dotchar, commentchar);
+      ClockConfigWrite(filename, binary, templateFilename, device, timestamp, dotchar, commentchar, diff,
+        baseFilename, resume, verifySamples);
+    }
+    break;
+
+    case ConvertClockConfig: {
+      ClockConfigConvert(filename, binary, templateFilename, outFilename, dotchar, commentchar, compact);
     }
     break;
 
     case SetDisplay: {
-      DisplayShowContent(filename, binary, device, dotchar, commentchar, delay, repeat);
+      DisplayShowContent(filename, binary, device, dotchar, commentchar, delay, repeat, dropLate, progress);
     }
     break;
 
@@ -259,6 +378,11 @@ int main(int numberOfArguments, char *arguments[])
     }
     break;
 
+    case RunDaemon: {
+      DaemonRun(device);
+    }
+    break;
+
     // Nothing to do
     default:
     case DoNoting: {
@@ -266,16 +390,28 @@ int main(int numberOfArguments, char *arguments[])
       fprintf(stderr,
         "ID100 Utility ("__DATE__" "__TIME__""GIT_STRING")\n"
         "Usage:\n"
-        " -d device               Use device instead of %s\n"
+        " -d device[,device..]    Use device instead of %s (-C writes several devices at once)\n"
         " -f file                 Use text file with filename for input / output\n"
         " -F file                 Use binary file with filename for input / output\n"
-        " -t hh:mm:ss[-hh:mm:ss]  Specify time or time range\n"
-        " -w n                    Wait n milliseconds between frames\n"
+        " -T template             Generate clock configuration from a clock face template (-C, -x)\n"
+        " -t hh:mm:ss[-hh:mm:ss]  Specify time or time range, several separated by commas (-c, -C)\n"
+        " -w n                    Show a frame every n milliseconds\n"
         " -r n                    Repeat frames n times\n"
+        " -k, --drop-late         Skip frames that are a whole frame period late instead of sending them (-S)\n"
         " -D dorchar              Specify dot character to use in ASCII pictures\n"
         " -m commentchar          Specify comment characters to use in ASCII pictures\n"
         " -c                      Read clock configuration from device\n"
+        " -l n                    Read clock configuration from local mirror, check n random pages on device\n"
         " -C                      Write clock configuration into device\n"
+        " -u                      Only rewrite sectors differing from the device contents\n"
+        " -B file                 Only rewrite sectors differing from binary file holding the device contents\n"
+        " -R, --resume            Resume an interrupted clock configuration write\n"
+        " -v[n], --verify[=n]     Read back written clock configuration (n random pages per sector) and repair it\n"
+        " -x file                 Convert clock configuration from -f / -F input to the other format into file\n"
+        " -P, --progress          Show progress, throughput and ETA of device operations (frame rate of -S) on stderr\n"
+        " -Y, --summary file      Append a JSON summary line of every long device operation to file\n"
+        " -n, --retries n         Repeat a command up to n times after a transmission error (default %u)\n"
+        " -z                      Save clock configuration as compact container (-c, -x), detected on input\n"
         " -s                      Set normal (clock) mode\n"
         " -S                      Set display contents\n"
         " -g                      Read current time from device\n"
@@ -284,7 +420,8 @@ int main(int numberOfArguments, char *arguments[])
         " -V                      Show firmware version\n"
         " -i                      Show intensity\n"
         " -I intensity(0-9)       Set intensity\n"
-        , defaultDevice
+        " -L, --daemon            Keep the device open and serve all other invocations for it through a socket\n"
+        , defaultDevice, APP_DEFAULT_RETRIES
       );
     }
     break;
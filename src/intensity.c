@@ -57,9 +57,10 @@ static const uint8_t intensityNumberOf = sizeof(intensityMap) / sizeof(intensity
 void IntensityPrint(char *filename, char *device)
 {
   // Get intensity
-  AppInit(device);
-  AppIntensityType intensity = AppGetIntensity();
-  AppCleanup();
+  AppType *app = OpenDevice(device);
+  AppIntensityType intensity;
+  ExitOnAppError(app, AppGetIntensity(app, &intensity));
+  CloseDevice(app);
 
   // Convert it to number
   uint8_t idx;
@@ -92,7 +93,7 @@ void IntensitySet(char *device, char *intensityParam)
   }
 
   // Convert to intensity and set it
-  AppInit(device);
-  AppSetIntensity(intensityMap[idx]);
-  AppCleanup();
+  AppType *app = OpenDevice(device);
+  ExitOnAppError(app, AppSetIntensity(app, intensityMap[idx]));
+  CloseDevice(app);
 }
@@ -0,0 +1,140 @@
+/***********************************************************************************************************************
+ *
+ * ID100 Utility
+ * Upload Journal
+ *
+ * (C) 2017 Gergely Budai
+ *
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ *
+ **********************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "journal.h"
+#include "app.h"
+#include "file.h"
+
+// Number of sectors in the clock configuration
+#define JOURNAL_SECTORS (APP_CLOCK_CONFIG_FLASH_PAGES / APP_FLASH_PAGES_PER_SECTOR)
+
+// Journal file header
+typedef struct {
+  char magic[8];
+  Hash64Type key;
+} JournalHeaderType;
+
+// One byte per sector follows the header, non-zero if the sector is written
+struct JournalStruct {
+  int fd;
+  char path[PATH_MAX];
+  uint8_t done[JOURNAL_SECTORS];
+};
+
+static const char journalMagic[8] = "ID100JNL";
+
+/***********************************************************************************************************************
+ * Open the journal for the given key, start a new one unless resuming or if there is none to resume, resumed tells
+ * which one happened. Returns NULL if the journal can not be created (e.g. there is no cache directory).
+ **********************************************************************************************************************/
+JournalType *JournalOpen(Hash64Type key, bool resume, bool *resumed)
+{
+  JournalType *journal;
+  JournalHeaderType header;
+  char name[32];
+
+  *resumed = false;
+  if((journal = calloc(1, sizeof(*journal))) == NULL) {
+    return NULL;
+  }
+
+  snprintf(name, sizeof(name), "%016llx.journal", (unsigned long long)key);
+  if(!FileGetCachePath(journal->path, sizeof(journal->path), name, true) ||
+     ((journal->fd = open(journal->path, O_RDWR | O_CREAT, 0644)) < 0)) {
+    free(journal);
+    return NULL;
+  }
+
+  // Load the journal if it belongs to the same key
+  if(resume &&
+     (pread(journal->fd, &header, sizeof(header), 0) == sizeof(header)) &&
+     (memcmp(header.magic, journalMagic, sizeof(header.magic)) == 0) &&
+     (header.key == key) &&
+     (pread(journal->fd, journal->done, sizeof(journal->done), sizeof(header)) == sizeof(journal->done))) {
+    *resumed = true;
+    return journal;
+  }
+
+  // Start a new journal
+  memcpy(header.magic, journalMagic, sizeof(header.magic));
+  header.key = key;
+  memset(journal->done, 0, sizeof(journal->done));
+  if((ftruncate(journal->fd, 0) != 0) ||
+     (pwrite(journal->fd, &header, sizeof(header), 0) != sizeof(header)) ||
+     (pwrite(journal->fd, journal->done, sizeof(journal->done), sizeof(header)) != sizeof(journal->done))) {
+    close(journal->fd);
+    unlink(journal->path);
+    free(journal);
+    return NULL;
+  }
+
+  return journal;
+}
+
+/***********************************************************************************************************************
+ * Check if a sector has already been written
+ **********************************************************************************************************************/
+bool JournalIsSectorDone(JournalType *journal, uint16_t sector)
+{
+  return journal->done[sector] != 0;
+}
+
+/***********************************************************************************************************************
+ * Record a written sector, return false if it can not be recorded
+ * The kernel keeps the write even if the process dies afterwards, so no sync is needed for the use case.
+ **********************************************************************************************************************/
+bool JournalSetSectorDone(JournalType *journal, uint16_t sector)
+{
+  journal->done[sector] = 1;
+  return pwrite(journal->fd, &journal->done[sector], 1, sizeof(JournalHeaderType) + sector) == 1;
+}
+
+/***********************************************************************************************************************
+ * Close the journal, remove it if the upload is complete (or the journal is of no use any more)
+ * The journal is freed in any case, returns false if it could not be closed or removed.
+ **********************************************************************************************************************/
+bool JournalClose(JournalType *journal, bool complete)
+{
+  bool ok = (close(journal->fd) == 0);
+
+  ok = (!complete || (unlink(journal->path) == 0)) && ok;
+  free(journal);
+
+  return ok;
+}
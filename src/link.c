@@ -34,9 +34,10 @@
 #include "link.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
+#include <stdarg.h>
 #include "crc16.h"
-#include "utils.h"
 #include "phy.h"
 
 //#define dprintf(...) printf(__VA_ARGS__); fflush(stdout)
@@ -45,146 +46,354 @@
 static const uint8_t STX = 0x02;
 static const uint8_t ENQ = 0x10;
 
+// Size of the receive buffer, big enough for a whole flash page answer
+#define LINK_RX_BUFFER_SIZE 1024
+
+// Link to one device
+struct LinkStruct {
+  PhyType *phy;
+  uint8_t frameBuffer[LINK_MAX_FRAME_LENGTH(LINK_MAX_BUFFER_LENGTH)];
+  // Data received from the physical layer, not yet fed to the decoder
+  uint8_t rxBuffer[LINK_RX_BUFFER_SIZE];
+  uint16_t rxHead, rxTail;
+  LinkDecoderType decoder;
+  // Description of the last error
+  char error[LINK_MAX_ERROR_LENGTH];
+};
+
+/***********************************************************************************************************************
+ * Connect the link and lower layers, return NULL with errno set on failure
+ **********************************************************************************************************************/
+LinkType *LinkConnect(void *ctx)
+{
+  LinkType *link;
+
+  if((link = malloc(sizeof(*link))) == NULL) {
+    return NULL;
+  }
+  if((link->phy = PhyOpen(ctx)) == NULL) {
+    free(link);
+    return NULL;
+  }
+  link->rxHead = link->rxTail = 0;
+  link->error[0] = '\0';
+
+  return link;
+}
+
+/***********************************************************************************************************************
+ * Disconnect the link and lower layers, LinkIoError with errno set if the port could not be released cleanly
+ **********************************************************************************************************************/
+LinkStatusType LinkDisconnect(LinkType *link)
+{
+  PhyStatusType status = PhyClose(link->phy);
+
+  free(link);
+  return (status == PhyOk) ? LinkOk : LinkIoError;
+}
+
+/***********************************************************************************************************************
+ * Get the number of bytes sent and received on the wire so far
+ **********************************************************************************************************************/
+void LinkGetWireBytes(LinkType *link, uint64_t *sent, uint64_t *received)
+{
+  PhyGetWireBytes(link->phy, sent, received);
+}
+
+/***********************************************************************************************************************
+ * Tell if the device is served by a daemon through a socket
+ **********************************************************************************************************************/
+bool LinkIsSocket(LinkType *link)
+{
+  return PhyIsSocket(link->phy);
+}
+
 /***********************************************************************************************************************
- * Connect the link and lower layers
+ * Get the description of the last error
  **********************************************************************************************************************/
-void LinkConnect(void *ctx)
+const char *LinkGetError(LinkType *link)
 {
-  PhyOpen(ctx);
+  return link->error;
 }
 
 /***********************************************************************************************************************
- * Disconnect the link and lower layers
+ * Remember the description of an error and return its status
  **********************************************************************************************************************/
-void LinkDisconnect(void)
+static LinkStatusType LinkError(LinkType *link, LinkStatusType status, const char *fmt, ...)
 {
-  PhyClose();
+  va_list va;
+
+  va_start(va, fmt);
+  vsnprintf(link->error, sizeof(link->error), fmt, va);
+  va_end(va);
+
+  return status;
 }
 
 /***********************************************************************************************************************
- * Send one byte to the physical layer and update CRC
+ * Translate a physical layer failure into a link status
  **********************************************************************************************************************/
-static Crc16Type LinkSendByte(uint8_t byte, Crc16Type crc)
+static LinkStatusType LinkPhyError(LinkType *link, PhyStatusType status)
 {
-  PhySendByte(byte);
-  dprintf("%02X ", byte);
+  if(status == PhyTimeout) {
+    return LinkError(link, LinkTimeout, "Timeout while receiving");
+  }
+
+  return LinkError(link, LinkIoError, "Device I/O error");
+}
+
+/***********************************************************************************************************************
+ * Drop everything received so far to get back in sync with the frames
+ **********************************************************************************************************************/
+LinkStatusType LinkResync(LinkType *link, uint32_t quietTime)
+{
+  PhyStatusType status;
+
+  link->rxHead = link->rxTail = 0;
+  if((status = PhyFlushReceive(link->phy, quietTime)) != PhyOk) {
+    return LinkPhyError(link, status);
+  }
 
-  return(Crc16UpdateByte(crc, byte));
+  return LinkOk;
 }
 
 /***********************************************************************************************************************
- * Encode and send special bytes and update CRC
+ * Encode special bytes into the frame buffer
  **********************************************************************************************************************/
-static Crc16Type LinkEncodeByte(uint8_t byte, Crc16Type crc)
+static void LinkEncodeByte(uint8_t **frame, uint8_t byte)
 {
   if((byte == STX) || (byte == ENQ)) {
-    crc = LinkSendByte(ENQ, crc);
+    *(*frame)++ = ENQ;
     byte += 0x80;
   }
 
-  crc = LinkSendByte(byte, crc);
+  *(*frame)++ = byte;
+}
+
+/***********************************************************************************************************************
+ * Build a frame around the given command and buffer, return its length
+ * The frame has to hold LINK_MAX_FRAME_LENGTH(length) bytes.
+ **********************************************************************************************************************/
+uint16_t LinkEncodeFrame(uint8_t *frameBuffer, const uint8_t command, const void *buffer, const uint16_t length)
+{
+  uint8_t *frame = frameBuffer;
+  Crc16Type crc;
+  uint16_t i;
 
-  return crc;
+  // Put STX (Not encoded)
+  *frame++ = STX;
+  // Put length (command plus buffer)
+  LinkEncodeByte(&frame, (length + 1) >> 8);
+  LinkEncodeByte(&frame, (length + 1));
+  // Put Command
+  LinkEncodeByte(&frame, command);
+  // Put Buffer as bytes
+  for(i = 0; i < length; i++) {
+    LinkEncodeByte(&frame, ((uint8_t *)buffer)[i]);
+  }
+  // CRC covers the encoded frame as it goes over the wire
+  crc = Crc16CalculateBuffer(frameBuffer, frame - frameBuffer);
+  // Put CRC
+  LinkEncodeByte(&frame, crc >> 8);
+  LinkEncodeByte(&frame, crc);
+
+  return frame - frameBuffer;
 }
 
 /***********************************************************************************************************************
  * Build a frame around the given command and buffer and send it to physical layer
  **********************************************************************************************************************/
-void LinkSendCommandAndBuffer(const uint8_t command, const void *buffer, const uint16_t length)
+LinkStatusType LinkSendCommandAndBuffer(LinkType *link, const uint8_t command, const void *buffer, const uint16_t length)
 {
-  Crc16Type crc = 0xFFFF;
-  uint16_t i;
+  PhyStatusType status;
+  uint16_t frameLength, i;
+
+  if(length > LINK_MAX_BUFFER_LENGTH) {
+    return LinkError(link, LinkTooBig, "Send data too big: %u", length);
+  }
+
+  frameLength = LinkEncodeFrame(link->frameBuffer, command, buffer, length);
 
   dprintf("TX: ");
-  // Send STX (Not encoded)
-  crc = LinkSendByte(STX, crc);
-  // Send length (command plus buffer)
-  crc = LinkEncodeByte((length + 1) >> 8, crc);
-  crc = LinkEncodeByte((length + 1), crc);
-  // Send Command
-  crc = LinkEncodeByte(command, crc);
-  // Send Buffer as bytes
-  for(i = 0; i < length; i++) {
-    crc = LinkEncodeByte(((uint8_t *)buffer)[i], crc);
+  for(i = 0; i < frameLength; i++) {
+    dprintf("%02X ", link->frameBuffer[i]);
   }
-  // Send CRC
-  LinkEncodeByte(crc >> 8, 0);
-  LinkEncodeByte(crc, 0);
   dprintf("\n");
+
+  // Send the whole frame at once
+  if((status = PhySendBuffer(link->phy, link->frameBuffer, frameLength)) != PhyOk) {
+    return LinkPhyError(link, status);
+  }
+
+  return LinkOk;
 }
 
 /***********************************************************************************************************************
- * Receive one byte over the link layer and update CRC
+ * Start decoding a new frame into the buffer
  **********************************************************************************************************************/
-static Crc16Type LinkReceiveByte(uint8_t *byte, Crc16Type crc)
+void LinkDecoderInit(LinkDecoderType *decoder, void *buffer, uint16_t bufLen)
 {
-  *byte = PhyReceiveByte();
-  dprintf("%02X ", *byte);
-
-  return(Crc16UpdateByte(crc, *byte));
+  decoder->state = LinkDecoderHunt;
+  decoder->escape = false;
+  decoder->buffer = buffer;
+  decoder->bufLen = bufLen;
+  decoder->discarded = 0;
 }
 
 /***********************************************************************************************************************
- * Receive and decode special bytes and update CRC
+ * Feed received data to the decoder, stop at the first event. The number of bytes used up is returned in consumed,
+ * the rest has to be fed again. After an error the decoder looks for the next frame start by itself.
  **********************************************************************************************************************/
-static Crc16Type LinkDecodeByte(uint8_t *byte, Crc16Type crc)
+LinkDecoderEventType LinkDecoderPush(LinkDecoderType *decoder, const uint8_t *data, uint16_t length,
+  uint16_t *consumed)
 {
-  crc = LinkReceiveByte(byte, crc);
+  LinkDecoderEventType event = LinkDecoderMore;
+  uint16_t i;
 
-  if(*byte == ENQ) {
-    crc = LinkReceiveByte(byte, crc);
-    *byte -= 0x80;
+  for(i = 0; (i < length) && (event == LinkDecoderMore); i++) {
+    uint8_t byte = data[i];
+
+    // STX is never escaped, so it always starts a new frame
+    if(byte == STX) {
+      if(decoder->state != LinkDecoderHunt) {
+        event = LinkDecoderBadFrame;
+      }
+      decoder->state = LinkDecoderLengthHigh;
+      decoder->escape = false;
+      decoder->crc = Crc16UpdateByte(0xFFFF, byte);
+      continue;
+    }
+
+    if(decoder->state == LinkDecoderHunt) {
+      decoder->discarded++;
+      continue;
+    }
+
+    // CRC covers the encoded frame as it goes over the wire, but not itself
+    if(decoder->state < LinkDecoderCrcHigh) {
+      decoder->crc = Crc16UpdateByte(decoder->crc, byte);
+    }
+
+    // Escape may be split from its byte by the end of the data
+    if(!decoder->escape && (byte == ENQ)) {
+      decoder->escape = true;
+      continue;
+    }
+    if(decoder->escape) {
+      byte -= 0x80;
+      decoder->escape = false;
+    }
+
+    switch(decoder->state) {
+      case LinkDecoderLengthHigh: {
+        decoder->length = (uint16_t)byte << 8;
+        decoder->state = LinkDecoderLengthLow;
+      }
+      break;
+
+      // Length covers command and buffer
+      case LinkDecoderLengthLow: {
+        decoder->length |= byte;
+        if(decoder->length == 0) {
+          decoder->state = LinkDecoderHunt;
+          event = LinkDecoderBadFrame;
+        }
+        else if(--decoder->length > decoder->bufLen) {
+          decoder->state = LinkDecoderHunt;
+          event = LinkDecoderTooBig;
+        }
+        else {
+          decoder->state = LinkDecoderCommand;
+        }
+      }
+      break;
+
+      case LinkDecoderCommand: {
+        decoder->command = byte;
+        decoder->received = 0;
+        decoder->state = decoder->length ? LinkDecoderData : LinkDecoderCrcHigh;
+      }
+      break;
+
+      case LinkDecoderData: {
+        decoder->buffer[decoder->received++] = byte;
+        if(decoder->received == decoder->length) {
+          decoder->state = LinkDecoderCrcHigh;
+        }
+      }
+      break;
+
+      case LinkDecoderCrcHigh: {
+        decoder->crcIn = (Crc16Type)byte << 8;
+        decoder->state = LinkDecoderCrcLow;
+      }
+      break;
+
+      case LinkDecoderCrcLow: {
+        decoder->crcIn |= byte;
+        decoder->state = LinkDecoderHunt;
+        event = (decoder->crc == decoder->crcIn) ? LinkDecoderFrame : LinkDecoderCrcError;
+      }
+      break;
+
+      default:
+      break;
+    }
   }
 
-  return crc;
+  *consumed = i;
+  return event;
 }
 
 /***********************************************************************************************************************
- * Receive and check a frame from the physical layer
+ * Receive and check a frame from the physical layer, the received data length is returned in length
+ * Anything before the frame start is skipped and frames broken off by a new start are dropped, so stray bytes on the
+ * line do not break the communication.
  **********************************************************************************************************************/
-uint16_t LinkReceiveCommandAndBuffer(uint8_t *command, void *buffer, uint16_t bufLen)
+LinkStatusType LinkReceiveCommandAndBuffer(LinkType *link, uint8_t *command, void *buffer, uint16_t bufLen,
+  uint16_t *length)
 {
-  Crc16Type crc = 0xFFFF, crcIn;
-  uint8_t byte;
-  uint16_t i, length;
+  LinkDecoderType *decoder = &link->decoder;
+  LinkDecoderEventType event;
+  PhyStatusType status;
+  uint16_t consumed, broken = 0;
 
-  dprintf("RX: ");
+  LinkDecoderInit(decoder, buffer, bufLen);
 
-  // Receive STX (Not encoded)
-  crc = LinkReceiveByte(&byte, crc);
-  if(byte != STX) {
-    ExitWithError("Bad packet start byte: %02X", byte);
-  }
-
-  // Receive length (command and buffer)
-  crc = LinkDecodeByte(&byte, crc);
-  length = (uint16_t)byte << 8;
-  crc = LinkDecodeByte(&byte, crc);
-  length |= (uint16_t)byte;
-  length--;
-  if(length > bufLen) {
-    ExitWithError("Receive data too big: %u", length);
-  }
+  do {
+    // Get more data if everything has been decoded
+    if(link->rxHead == link->rxTail) {
+      link->rxHead = 0;
+      if((status = PhyReceiveBuffer(link->phy, link->rxBuffer, sizeof(link->rxBuffer), &link->rxTail)) != PhyOk) {
+        link->rxTail = 0;
+        return LinkPhyError(link, status);
+      }
+    }
 
-  // Receive command
-  crc = LinkDecodeByte(command, crc);
+    event = LinkDecoderPush(decoder, &link->rxBuffer[link->rxHead], link->rxTail - link->rxHead, &consumed);
+    link->rxHead += consumed;
+    // The decoder hunts for the next frame start by itself
+    broken += (event == LinkDecoderBadFrame);
+  } while((event == LinkDecoderMore) || (event == LinkDecoderBadFrame));
 
-  // Receive Buffer as bytes
-  for(i = 0; i < length; i++) {
-    crc = LinkDecodeByte(&(((uint8_t *)buffer)[i]), crc);
+  if(decoder->discarded || broken) {
+    dprintf("RX: %u bytes skipped, %u broken frames before frame\n", decoder->discarded, broken);
   }
 
-  // Receive CRC
-  LinkDecodeByte(&byte, 0);
-  crcIn = (Crc16Type)byte << 8;
-  LinkDecodeByte(&byte, 0);
-  crcIn |= (Crc16Type)byte;
-  dprintf("\n");
+  switch(event) {
+    case LinkDecoderFrame: {
+      *command = decoder->command;
+      *length = decoder->length;
+      return LinkOk;
+    }
 
-  // Check CRC
-  if(crc != crcIn) {
-    ExitWithError("CRC Error, Calcualted: %04X, Received: %04X", crc, crcIn);
-  }
+    case LinkDecoderTooBig: {
+      return LinkError(link, LinkTooBig, "Receive data too big: %u", decoder->length);
+    }
 
-  return length;
+    default: {
+      return LinkError(link, LinkCrcError, "CRC Error, Calculated: %04X, Received: %04X", decoder->crc,
+        decoder->crcIn);
+    }
+  }
 }
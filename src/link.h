@@ -35,10 +35,86 @@
 #define LINK_H_
 
 #include <stdint.h>
+#include <stdbool.h>
+#include "crc16.h"
 
-void LinkConnect(void *ctx);
-void LinkDisconnect(void);
-void LinkSendCommandAndBuffer(const uint8_t command, const void *buffer, const uint16_t length);
-uint16_t LinkReceiveCommandAndBuffer(uint8_t *command, void *buffer, uint16_t bufLen);
+// Maximum size of the data buffer in one frame
+#define LINK_MAX_BUFFER_LENGTH 512
+
+// Worst case frame for a data buffer: STX plus every other byte escaped
+#define LINK_MAX_FRAME_LENGTH(length) (1 + (2 * (2 + 1 + (length) + 2)))
+
+// Maximum length of an error description
+#define LINK_MAX_ERROR_LENGTH 128
+
+typedef struct LinkStruct LinkType;
+
+typedef enum {
+  LinkOk = 0,
+  LinkTimeout,
+  LinkIoError,
+  LinkBadFrame,
+  LinkTooBig,
+  LinkCrcError
+} LinkStatusType;
+
+// State of the frame decoder
+typedef enum {
+  LinkDecoderHunt = 0,
+  LinkDecoderLengthHigh,
+  LinkDecoderLengthLow,
+  LinkDecoderCommand,
+  LinkDecoderData,
+  LinkDecoderCrcHigh,
+  LinkDecoderCrcLow
+} LinkDecoderStateType;
+
+// Result of feeding data to the frame decoder
+typedef enum {
+  // Frame not complete yet, feed more data
+  LinkDecoderMore = 0,
+  // Valid frame received
+  LinkDecoderFrame,
+  // Frame broken off by a new start byte or invalid length
+  LinkDecoderBadFrame,
+  // Frame does not fit into the buffer
+  LinkDecoderTooBig,
+  // Frame CRC does not match
+  LinkDecoderCrcError
+} LinkDecoderEventType;
+
+// Incremental frame decoder, can be fed with chunks of any size
+typedef struct {
+  LinkDecoderStateType state;
+  // Last byte was an escape character
+  bool escape;
+  // Destination of the frame data
+  uint8_t *buffer;
+  uint16_t bufLen;
+  // Frame being decoded
+  uint8_t command;
+  uint16_t length;
+  uint16_t received;
+  Crc16Type crc;
+  Crc16Type crcIn;
+  // Bytes thrown away while looking for a frame start
+  uint32_t discarded;
+} LinkDecoderType;
+
+uint16_t LinkEncodeFrame(uint8_t *frameBuffer, const uint8_t command, const void *buffer, const uint16_t length);
+void LinkDecoderInit(LinkDecoderType *decoder, void *buffer, uint16_t bufLen);
+LinkDecoderEventType LinkDecoderPush(LinkDecoderType *decoder, const uint8_t *data, uint16_t length,
+  uint16_t *consumed);
+
+LinkType *LinkConnect(void *ctx);
+LinkStatusType LinkDisconnect(LinkType *link);
+void LinkGetWireBytes(LinkType *link, uint64_t *sent, uint64_t *received);
+bool LinkIsSocket(LinkType *link);
+const char *LinkGetError(LinkType *link);
+LinkStatusType LinkResync(LinkType *link, uint32_t quietTime);
+LinkStatusType LinkSendCommandAndBuffer(LinkType *link, const uint8_t command, const void *buffer,
+  const uint16_t length);
+LinkStatusType LinkReceiveCommandAndBuffer(LinkType *link, uint8_t *command, void *buffer, uint16_t bufLen,
+  uint16_t *length);
 
 #endif // LINK_H_
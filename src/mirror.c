@@ -0,0 +1,181 @@
+/***********************************************************************************************************************
+ *
+ * ID100 Utility
+ * Local Mirror of the Device Flash
+ *
+ * (C) 2017 Gergely Budai
+ *
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ *
+ **********************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "mirror.h"
+#include "hash.h"
+#include "file.h"
+#include "utils.h"
+
+// Per sector bookkeeping
+typedef struct {
+  Hash64Type hash;
+  uint8_t valid;
+  uint8_t reserved[7];
+} MirrorSectorType;
+
+// Layout of the mirror file, mapped into memory so every update survives an abort
+typedef struct {
+  char magic[8];
+  MirrorSectorType sectors[MIRROR_SECTORS];
+  AppClockMatrixBitmap pages[APP_CLOCK_CONFIG_FLASH_PAGES];
+} MirrorFileType;
+
+struct MirrorStruct {
+  int fd;
+  MirrorFileType *file;
+};
+
+static const char mirrorMagic[8] = "ID100MIR";
+
+/***********************************************************************************************************************
+ * Open (or create) the mirror belonging to a device path
+ * Without a usable cache directory or file the mirror only lives in memory, knowing nothing in the beginning.
+ **********************************************************************************************************************/
+MirrorType *MirrorOpen(const char *device)
+{
+  MirrorType *mirror;
+  char path[PATH_MAX];
+
+  if((mirror = malloc(sizeof(*mirror))) == NULL) {
+    ExitWithError("Out of memory");
+  }
+
+  // Space is allocated up front, a full file system would otherwise fault on writing the mapped file later
+  mirror->file = MAP_FAILED;
+  if(FileGetDeviceCachePath(path, sizeof(path), device, ".mirror", true) &&
+     ((mirror->fd = open(path, O_RDWR | O_CREAT, 0644)) >= 0)) {
+    if(posix_fallocate(mirror->fd, 0, sizeof(MirrorFileType)) == 0) {
+      mirror->file = mmap(NULL, sizeof(MirrorFileType), PROT_READ | PROT_WRITE, MAP_SHARED, mirror->fd, 0);
+    }
+    if(mirror->file == MAP_FAILED) {
+      fprintf(stderr, "Warning: Unable to use mirror %s, keeping it in memory only\n", path);
+      close(mirror->fd);
+    }
+  }
+
+  if(mirror->file == MAP_FAILED) {
+    mirror->fd = -1;
+    mirror->file = mmap(NULL, sizeof(MirrorFileType), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mirror->file == MAP_FAILED) {
+      ExitWithError("Unable to map mirror");
+    }
+  }
+
+  // Start over if the file is new or unknown
+  if(memcmp(mirror->file->magic, mirrorMagic, sizeof(mirrorMagic)) != 0) {
+    MirrorInvalidate(mirror);
+    memcpy(mirror->file->magic, mirrorMagic, sizeof(mirrorMagic));
+  }
+
+  return mirror;
+}
+
+/***********************************************************************************************************************
+ * Close the mirror, it is freed in any case, returns false if it could not be closed cleanly
+ **********************************************************************************************************************/
+bool MirrorClose(MirrorType *mirror)
+{
+  bool ok = (munmap(mirror->file, sizeof(MirrorFileType)) == 0);
+
+  ok = ((mirror->fd < 0) || (close(mirror->fd) == 0)) && ok;
+  free(mirror);
+
+  return ok;
+}
+
+/***********************************************************************************************************************
+ * Calculate the hash of a sector in the mirror
+ **********************************************************************************************************************/
+static Hash64Type MirrorHashSector(MirrorType *mirror, uint16_t sector)
+{
+  return Hash64CalculateBuffer(mirror->file->pages[sector * APP_FLASH_PAGES_PER_SECTOR],
+    sizeof(AppClockMatrixBitmap) * APP_FLASH_PAGES_PER_SECTOR);
+}
+
+/***********************************************************************************************************************
+ * Check if the mirror holds the actual contents of a sector
+ **********************************************************************************************************************/
+bool MirrorIsSectorValid(MirrorType *mirror, uint16_t sector)
+{
+  MirrorSectorType *entry = &mirror->file->sectors[sector];
+
+  return entry->valid && (entry->hash == MirrorHashSector(mirror, sector));
+}
+
+/***********************************************************************************************************************
+ * Mark a sector as unknown (e.g. before it gets modified)
+ **********************************************************************************************************************/
+void MirrorInvalidateSector(MirrorType *mirror, uint16_t sector)
+{
+  mirror->file->sectors[sector].valid = 0;
+}
+
+/***********************************************************************************************************************
+ * Mark the whole mirror as unknown
+ **********************************************************************************************************************/
+void MirrorInvalidate(MirrorType *mirror)
+{
+  memset(mirror->file->sectors, 0, sizeof(mirror->file->sectors));
+}
+
+/***********************************************************************************************************************
+ * Mark a sector as known, after all of its pages are set
+ **********************************************************************************************************************/
+void MirrorValidateSector(MirrorType *mirror, uint16_t sector)
+{
+  mirror->file->sectors[sector].hash = MirrorHashSector(mirror, sector);
+  mirror->file->sectors[sector].valid = 1;
+}
+
+/***********************************************************************************************************************
+ * Get a page from the mirror
+ **********************************************************************************************************************/
+AppClockMatrixBitmap *MirrorGetPage(MirrorType *mirror, uint16_t page)
+{
+  return &mirror->file->pages[page];
+}
+
+/***********************************************************************************************************************
+ * Set a page in the mirror
+ **********************************************************************************************************************/
+void MirrorSetPage(MirrorType *mirror, uint16_t page, const AppClockMatrixBitmap matrixBitmap)
+{
+  memcpy(mirror->file->pages[page], matrixBitmap, sizeof(AppClockMatrixBitmap));
+}
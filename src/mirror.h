@@ -0,0 +1,55 @@
+/***********************************************************************************************************************
+ *
+ * ID100 Utility
+ * Local Mirror of the Device Flash
+ *
+ * (C) 2017 Gergely Budai
+ *
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ *
+ **********************************************************************************************************************/
+#ifndef MIRROR_H_
+#define MIRROR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "app.h"
+
+// Number of sectors in the clock configuration
+#define MIRROR_SECTORS (APP_CLOCK_CONFIG_FLASH_PAGES / APP_FLASH_PAGES_PER_SECTOR)
+
+typedef struct MirrorStruct MirrorType;
+
+MirrorType *MirrorOpen(const char *device);
+bool MirrorClose(MirrorType *mirror);
+bool MirrorIsSectorValid(MirrorType *mirror, uint16_t sector);
+void MirrorInvalidateSector(MirrorType *mirror, uint16_t sector);
+void MirrorInvalidate(MirrorType *mirror);
+void MirrorValidateSector(MirrorType *mirror, uint16_t sector);
+AppClockMatrixBitmap *MirrorGetPage(MirrorType *mirror, uint16_t page);
+void MirrorSetPage(MirrorType *mirror, uint16_t page, const AppClockMatrixBitmap matrixBitmap);
+
+#endif // MIRROR_H_
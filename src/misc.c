@@ -34,6 +34,7 @@
 #include "misc.h"
 #include "file.h"
 #include "app.h"
+#include "utils.h"
 
 /***********************************************************************************************************************
  * Print Firmware Version
@@ -41,10 +42,10 @@
 void MiscPrintFirmwareVersion(char *filename, char *device)
 {
   // Get firmware version
-  AppInit(device);
+  AppType *app = OpenDevice(device);
   AppVersionType fwVersion;
-  AppGetVersion(&fwVersion);
-  AppCleanup();
+  ExitOnAppError(app, AppGetVersion(app, &fwVersion));
+  CloseDevice(app);
 
   // Print it
   FILE *file = FileOpen(filename, true);
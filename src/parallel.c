@@ -0,0 +1,106 @@
+/***********************************************************************************************************************
+ *
+ * ID100 Utility
+ * Parallel Execution
+ *
+ * (C) 2017 Gergely Budai
+ *
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ *
+ **********************************************************************************************************************/
+#include <unistd.h>
+#include <pthread.h>
+#include "parallel.h"
+#include "utils.h"
+
+// Work of one thread
+typedef struct {
+  ParallelFunctionType function;
+  void *context;
+  uint32_t start;
+  uint32_t end;
+} ParallelWorkType;
+
+/***********************************************************************************************************************
+ * Get the number of threads to use (one per processor)
+ **********************************************************************************************************************/
+unsigned int ParallelGetThreads(void)
+{
+  long processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if(processors < 1) {
+    processors = 1;
+  }
+  else if(processors > PARALLEL_MAX_THREADS) {
+    processors = PARALLEL_MAX_THREADS;
+  }
+
+  return processors;
+}
+
+/***********************************************************************************************************************
+ * Thread entry
+ **********************************************************************************************************************/
+static void *ParallelWorker(void *arg)
+{
+  ParallelWorkType *work = arg;
+
+  work->function(work->context, work->start, work->end);
+
+  return NULL;
+}
+
+/***********************************************************************************************************************
+ * Process count items on all processors, split into one contiguous range per thread
+ **********************************************************************************************************************/
+void ParallelRun(uint32_t count, ParallelFunctionType function, void *context)
+{
+  ParallelWorkType work[PARALLEL_MAX_THREADS];
+  pthread_t threads[PARALLEL_MAX_THREADS];
+  unsigned int numberOfThreads = ParallelGetThreads(), i;
+
+  if(numberOfThreads > count) {
+    numberOfThreads = count ? count : 1;
+  }
+
+  for(i = 0; i < numberOfThreads; i++) {
+    work[i].function = function;
+    work[i].context = context;
+    work[i].start = ((uint64_t)count * i) / numberOfThreads;
+    work[i].end = ((uint64_t)count * (i + 1)) / numberOfThreads;
+  }
+
+  // The first range is processed by the calling thread
+  for(i = 1; i < numberOfThreads; i++) {
+    if(pthread_create(&threads[i], NULL, ParallelWorker, &work[i]) != 0) {
+      ExitWithError("Unable to start worker thread");
+    }
+  }
+  ParallelWorker(&work[0]);
+  for(i = 1; i < numberOfThreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+}
@@ -0,0 +1,192 @@
+/***********************************************************************************************************************
+ *
+ * ID100 Utility
+ * Parallel Bitmap Text Parser
+ *
+ * (C) 2017 Gergely Budai
+ *
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ *
+ **********************************************************************************************************************/
+#include <string.h>
+#include "parser.h"
+#include "parallel.h"
+#include "bitmap.h"
+
+// One chunk of text, parsed by one thread
+typedef struct {
+  const char *start;
+  const char *end;
+  const char *textEnd;
+  // First bitmap row (counted over all non-comment lines) in this chunk
+  uint32_t firstLine;
+  // Number of lines belonging to a bitmap started in the previous chunk
+  uint32_t skipLines;
+  // Number of non-comment lines in this chunk
+  uint32_t lines;
+  // Output
+  AppMatrixBitmapType *bitmaps;
+  uint32_t count;
+  char dotchar;
+  char commentchar;
+} ParserChunkType;
+
+/***********************************************************************************************************************
+ * Get the end of the line starting at text (position of the newline or the end of the chunk)
+ **********************************************************************************************************************/
+static inline const char *ParserLineEnd(const char *text, const char *end)
+{
+  const char *newline = memchr(text, '\n', end - text);
+
+  return newline ? newline : end;
+}
+
+/***********************************************************************************************************************
+ * Count the bitmap lines of a chunk
+ **********************************************************************************************************************/
+static void ParserCountChunk(ParserChunkType *chunk)
+{
+  const char *line, *lineEnd;
+
+  chunk->lines = 0;
+  for(line = chunk->start; line < chunk->end; line = lineEnd + 1) {
+    lineEnd = ParserLineEnd(line, chunk->end);
+    if(*line != chunk->commentchar) {
+      chunk->lines++;
+    }
+  }
+}
+
+/***********************************************************************************************************************
+ * Parse the bitmaps starting in a chunk
+ * Rows of one bitmap share bytes, so every bitmap is parsed completely by the thread of the chunk it starts in,
+ * even if it continues in the next chunk.
+ **********************************************************************************************************************/
+static void ParserParseChunk(ParserChunkType *chunk)
+{
+  const char *line, *lineEnd;
+  uint32_t lineIdx = chunk->firstLine;
+
+  for(line = chunk->start; line < chunk->textEnd; line = lineEnd + 1) {
+    // Stop at the first bitmap starting after this chunk
+    if((line >= chunk->end) && ((lineIdx % BITMAP_ROWS) == 0)) {
+      break;
+    }
+    // Stop if all bitmaps are read
+    if((lineIdx / BITMAP_ROWS) >= chunk->count) {
+      break;
+    }
+
+    lineEnd = ParserLineEnd(line, chunk->textEnd);
+    if(*line == chunk->commentchar) {
+      continue;
+    }
+
+    // Parse the line, unless it is the rest of a bitmap from the previous chunk
+    if((lineIdx - chunk->firstLine) >= chunk->skipLines) {
+      AppMatrixBitmapType *bitmap = &chunk->bitmaps[lineIdx / BITMAP_ROWS];
+      uint8_t row = lineIdx % BITMAP_ROWS, column;
+      // Dots are on even positions only
+      for(column = 0; (column < BITMAP_COLS) && ((line + (column * 2)) < lineEnd); column++) {
+        if(line[column * 2] == chunk->dotchar) {
+          BitmapSetDot(*bitmap, BitmapDotSet, row, column);
+        }
+      }
+    }
+    lineIdx++;
+  }
+}
+
+/***********************************************************************************************************************
+ * Worker: count the bitmap lines of the chunks start..end-1
+ **********************************************************************************************************************/
+static void ParserCountLines(void *context, uint32_t start, uint32_t end)
+{
+  ParserChunkType *chunks = context;
+
+  for(; start < end; start++) {
+    ParserCountChunk(&chunks[start]);
+  }
+}
+
+/***********************************************************************************************************************
+ * Worker: parse the bitmaps of the chunks start..end-1
+ **********************************************************************************************************************/
+static void ParserParseLines(void *context, uint32_t start, uint32_t end)
+{
+  ParserChunkType *chunks = context;
+
+  for(; start < end; start++) {
+    ParserParseChunk(&chunks[start]);
+  }
+}
+
+/***********************************************************************************************************************
+ * Parse up to count ASCII pictures from a text buffer using all processors
+ * Returns the number of bitmap lines (non-comment lines) found in the whole text.
+ **********************************************************************************************************************/
+uint32_t ParserReadBitmaps(const char *text, size_t length, AppMatrixBitmapType *bitmaps, uint32_t count,
+  char dotchar, char commentchar)
+{
+  ParserChunkType chunks[PARALLEL_MAX_THREADS];
+  const char *end = text + length, *start = text;
+  unsigned int processors = ParallelGetThreads(), numberOfChunks, i;
+  uint32_t lines = 0;
+
+  // Split the text into chunks at line boundaries
+  for(numberOfChunks = 0; (numberOfChunks < processors) && (start < end); numberOfChunks++) {
+    ParserChunkType *chunk = &chunks[numberOfChunks];
+    const char *chunkEnd = text + ((length * (numberOfChunks + 1)) / processors);
+
+    chunkEnd = (chunkEnd > start) ? ParserLineEnd(chunkEnd - 1, end) : ParserLineEnd(start, end);
+    chunk->start = start;
+    chunk->end = (chunkEnd < end) ? (chunkEnd + 1) : end;
+    chunk->textEnd = end;
+    chunk->bitmaps = bitmaps;
+    chunk->count = count;
+    chunk->dotchar = dotchar;
+    chunk->commentchar = commentchar;
+    start = chunk->end;
+  }
+
+  if(numberOfChunks == 0) {
+    return 0;
+  }
+
+  // Count lines, so every chunk knows where its rows belong (one chunk per thread)
+  ParallelRun(numberOfChunks, ParserCountLines, chunks);
+  for(i = 0; i < numberOfChunks; i++) {
+    chunks[i].firstLine = lines;
+    chunks[i].skipLines = (BITMAP_ROWS - (lines % BITMAP_ROWS)) % BITMAP_ROWS;
+    lines += chunks[i].lines;
+  }
+
+  // Parse
+  memset(bitmaps, 0, sizeof(AppMatrixBitmapType) * count);
+  ParallelRun(numberOfChunks, ParserParseLines, chunks);
+
+  return lines;
+}
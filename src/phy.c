@@ -32,33 +32,99 @@
  *
  **********************************************************************************************************************/
 #include "phy.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <termios.h>
 #include <unistd.h>
+#include <limits.h>
 #include <sys/file.h>
-#include "utils.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "file.h"
 
-static int port = -1;
+// Time to wait for an answer from the daemon (ms), it does the retries towards the device itself
+#define PHY_SOCKET_TIMEOUT 10000
+
+// Connection to one device
+struct PhyStruct {
+  int port;
+  // Connected to the daemon owning the device instead of the device itself
+  bool socket;
+  // Bytes sent and received on the wire, counted per system call
+  uint64_t txBytes, rxBytes;
+};
+
+/***********************************************************************************************************************
+ * Get the path of the socket a daemon owning the device listens on, return false if there is none or it does not fit
+ * Only the daemon creates the cache directory, clients just look for the socket.
+ **********************************************************************************************************************/
+bool PhyGetSocketPath(struct sockaddr_un *address, const char *devName, bool create)
+{
+  char path[PATH_MAX];
+
+  if(!FileGetDeviceCachePath(path, sizeof(path), devName, ".sock", create) ||
+     (strlen(path) >= sizeof(address->sun_path))) {
+    return false;
+  }
+
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  strcpy(address->sun_path, path);
+  return true;
+}
+
+/***********************************************************************************************************************
+ * Connect to the daemon owning the device, return the socket or -1 if there is no daemon
+ **********************************************************************************************************************/
+static int PhyConnectDaemon(const char *devName)
+{
+  struct sockaddr_un address;
+  int port;
+
+  if(!PhyGetSocketPath(&address, devName, false) || ((port = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)) {
+    return -1;
+  }
+  if(connect(port, (struct sockaddr *)&address, sizeof(address)) != 0) {
+    close(port);
+    return -1;
+  }
+
+  return port;
+}
 
 /***********************************************************************************************************************
- * Open serial port
+ * Open serial port (or the daemon owning it), return NULL with errno set on failure
  **********************************************************************************************************************/
-void PhyOpen(char *devName)
+PhyType *PhyOpen(char *devName)
 {
   static const speed_t portSpeed = B38400;
   struct termios tty;
+  PhyType *phy;
+  int port, error;
 
-  port = open(devName, O_RDWR | O_NOCTTY | O_SYNC);
-  if(port < 0) {
-    ExitWithError("Could not open device: %s", devName);
+  if((phy = calloc(1, sizeof(*phy))) == NULL) {
+    return NULL;
+  }
+
+  // A running daemon serves the device without opening, locking and setting it up again
+  if((phy->port = PhyConnectDaemon(devName)) >= 0) {
+    phy->socket = true;
+    errno = 0;
+    return phy;
   }
 
-  if(flock(port, LOCK_EX) != 0) {
-    ExitWithError("Could not lock device: %s", devName);
+  port = phy->port = open(devName, O_RDWR | O_NOCTTY);
+  if(port < 0) {
+    free(phy);
+    return NULL;
   }
 
-  if(tcgetattr(port, &tty) < 0) {
-    ExitWithError("Could not get attributes");
+  if((flock(port, LOCK_EX) != 0) || (tcgetattr(port, &tty) < 0)) {
+    goto fail;
   }
 
   cfsetospeed(&tty, portSpeed);
@@ -80,44 +146,142 @@ void PhyOpen(char *devName)
   tty.c_cc[VTIME] = 10;
 
   if (tcsetattr(port, TCSANOW, &tty) != 0) {
-    ExitWithError("Could not set attributes");
+    goto fail;
+  }
+
+  // Start with empty buffers, dropping anything left over from an interrupted run
+  if(tcflush(port, TCIOFLUSH) != 0) {
+    goto fail;
   }
+
+  return phy;
+
+fail:
+  // Keep the reason of the failure for the caller
+  error = errno;
+  close(port);
+  free(phy);
+  errno = error;
+  return NULL;
 }
 
 /***********************************************************************************************************************
- * Close serial port
+ * Close serial port, the port is closed in any case and errno tells about the first failure
  **********************************************************************************************************************/
-void PhyClose(void)
+PhyStatusType PhyClose(PhyType *phy)
 {
-  if(flock(port, LOCK_UN) != 0) {
-    ExitWithError("Could not unlock device");
+  PhyStatusType status = PhyOk;
+
+  if(!phy->socket && (flock(phy->port, LOCK_UN) != 0)) {
+    status = PhyIoError;
   }
 
-  if(close(port) != 0) {
-    ExitWithError("Could not close device");
+  if((close(phy->port) != 0) && (status == PhyOk)) {
+    status = PhyIoError;
   }
+
+  free(phy);
+  return status;
 }
 
 /***********************************************************************************************************************
- * Send one byte to serial port
+ * Send a buffer to serial port and wait until it is transmitted
  **********************************************************************************************************************/
-void PhySendByte(uint8_t byte)
+PhyStatusType PhySendBuffer(PhyType *phy, const uint8_t *buffer, uint16_t length)
 {
-  if(write(port, &byte, 1) != 1) {
-    ExitWithError("Could not send byte");
+  while(length) {
+    ssize_t written = write(phy->port, buffer, length);
+    if(written < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      return PhyIoError;
+    }
+    buffer += written;
+    length -= written;
+    phy->txBytes += written;
   }
+
+  // Wait until everything is on the wire
+  if(!phy->socket && (tcdrain(phy->port) != 0)) {
+    return PhyIoError;
+  }
+
+  return PhyOk;
 }
 
 /***********************************************************************************************************************
- * Receive one byte from serial port
+ * Receive whatever the serial port has available (at least one byte) into the buffer
  **********************************************************************************************************************/
-uint8_t PhyReceiveByte(void)
+PhyStatusType PhyReceiveBuffer(PhyType *phy, uint8_t *buffer, uint16_t size, uint16_t *received)
 {
-  uint8_t byte;
+  struct pollfd pollFd = { .fd = phy->port, .events = POLLIN };
+  ssize_t length;
+  int ready;
 
-  if(read(port, &byte, 1) != 1) {
-    ExitWithError("Could not receive byte");
+  // Sockets have no inter-byte timeout of their own
+  if(phy->socket) {
+    do {
+      ready = poll(&pollFd, 1, PHY_SOCKET_TIMEOUT);
+    } while((ready < 0) && (errno == EINTR));
+    if(ready < 0) {
+      return PhyIoError;
+    }
+    if(ready == 0) {
+      return PhyTimeout;
+    }
+  }
+
+  do {
+    length = read(phy->port, buffer, size);
+  } while((length < 0) && (errno == EINTR));
+
+  if(length < 0) {
+    return PhyIoError;
+  }
+  // Nothing arrived within the inter-byte timeout, or the daemon went away
+  if(length == 0) {
+    return phy->socket ? PhyIoError : PhyTimeout;
   }
 
-  return byte;
+  *received = length;
+  phy->rxBytes += length;
+
+  return PhyOk;
+}
+
+/***********************************************************************************************************************
+ * Drop all received data after the line went quiet for the given time, to resynchronize after an error
+ **********************************************************************************************************************/
+PhyStatusType PhyFlushReceive(PhyType *phy, uint32_t quietTime)
+{
+  uint8_t buffer[256];
+
+  // Let the rest of a broken answer arrive before throwing it away
+  usleep(quietTime);
+  if(phy->socket) {
+    while(recv(phy->port, buffer, sizeof(buffer), MSG_DONTWAIT) > 0);
+  }
+  else if(tcflush(phy->port, TCIFLUSH) != 0) {
+    return PhyIoError;
+  }
+
+  return PhyOk;
+}
+
+/***********************************************************************************************************************
+ * Get the number of bytes sent and received on the wire so far
+ **********************************************************************************************************************/
+void PhyGetWireBytes(PhyType *phy, uint64_t *sent, uint64_t *received)
+{
+  *sent = phy->txBytes;
+  *received = phy->rxBytes;
+}
+
+/***********************************************************************************************************************
+ * Tell if the device is served by a daemon through a socket
+ **********************************************************************************************************************/
+bool PhyIsSocket(PhyType *phy)
+{
+  return phy->socket;
 }
@@ -35,10 +35,24 @@
 #define PHY_H_
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <sys/un.h>
 
-void PhyOpen(char *devName);
-void PhyClose(void);
-void PhySendByte(uint8_t byte);
-uint8_t PhyReceiveByte(void);
+typedef struct PhyStruct PhyType;
+
+typedef enum {
+  PhyOk = 0,
+  PhyTimeout,
+  PhyIoError
+} PhyStatusType;
+
+bool PhyGetSocketPath(struct sockaddr_un *address, const char *devName, bool create);
+PhyType *PhyOpen(char *devName);
+PhyStatusType PhyClose(PhyType *phy);
+PhyStatusType PhySendBuffer(PhyType *phy, const uint8_t *buffer, uint16_t length);
+PhyStatusType PhyReceiveBuffer(PhyType *phy, uint8_t *buffer, uint16_t size, uint16_t *received);
+PhyStatusType PhyFlushReceive(PhyType *phy, uint32_t quietTime);
+void PhyGetWireBytes(PhyType *phy, uint64_t *sent, uint64_t *received);
+bool PhyIsSocket(PhyType *phy);
 
 #endif // PHY_H_
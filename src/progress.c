@@ -0,0 +1,260 @@
+/***********************************************************************************************************************
+ *
+ * ID100 Utility
+ * Progress Reporter
+ *
+ * (C) 2017 Gergely Budai
+ *
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ *
+ **********************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "progress.h"
+#include "app.h"
+#include "utils.h"
+
+// Minimum time between two progress lines in seconds
+#define PROGRESS_INTERVAL 0.5
+
+// Settings, the same for all tasks
+static bool show = false;
+static char *summaryFilename = NULL;
+// Tasks of several devices append to the summary file at once
+static pthread_mutex_t summaryLock = PTHREAD_MUTEX_INITIALIZER;
+
+// State of a running task
+struct ProgressStruct {
+  bool active;
+  AppType *app;
+  // Device label when several devices report at once
+  const char *device;
+  const char *task;
+  uint32_t total;
+  uint32_t done;
+  double startTime;
+  double shownTime;
+  uint64_t txBytes;
+  uint64_t rxBytes;
+  uint32_t retransmits;
+  uint32_t count[ProgressNumberOfOperations];
+  double seconds[ProgressNumberOfOperations];
+};
+
+/***********************************************************************************************************************
+ * Enable progress lines on stderr and / or a summary line appended to a file after every task
+ **********************************************************************************************************************/
+void ProgressSetup(bool showProgress, char *filename)
+{
+  show = showProgress;
+  summaryFilename = filename;
+}
+
+/***********************************************************************************************************************
+ * Get a monotonic time stamp in seconds
+ **********************************************************************************************************************/
+double ProgressGetTime(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + (now.tv_nsec / 1e9);
+}
+
+/***********************************************************************************************************************
+ * Get the number of bytes on the wire of the device used by the task (none if the device is not used)
+ **********************************************************************************************************************/
+static void ProgressGetWireBytes(ProgressType *progress, uint64_t *sent, uint64_t *received)
+{
+  *sent = *received = 0;
+  if(progress->app != NULL) {
+    AppGetWireBytes(progress->app, sent, received);
+  }
+}
+
+/***********************************************************************************************************************
+ * Get the number of commands the device used by the task had to repeat
+ **********************************************************************************************************************/
+static uint32_t ProgressGetRetransmits(ProgressType *progress)
+{
+  return (progress->app != NULL) ? AppGetRetransmits(progress->app) : 0;
+}
+
+/***********************************************************************************************************************
+ * Start a task processing the given number of pages on the device (app may be NULL if not used)
+ * The device label is printed in front of the output if given, progress lines are not redrawn in place then as other
+ * devices print too.
+ **********************************************************************************************************************/
+ProgressType *ProgressStart(AppType *app, const char *device, const char *task, uint32_t pages)
+{
+  ProgressType *progress;
+
+  if((progress = calloc(1, sizeof(*progress))) == NULL) {
+    ExitWithError("Out of memory");
+  }
+
+  progress->active = show || (summaryFilename != NULL);
+  progress->app = app;
+  progress->device = device;
+  progress->task = task;
+  progress->total = pages;
+  progress->startTime = progress->shownTime = ProgressGetTime();
+  ProgressGetWireBytes(progress, &progress->txBytes, &progress->rxBytes);
+  progress->retransmits = ProgressGetRetransmits(progress);
+
+  return progress;
+}
+
+/***********************************************************************************************************************
+ * Print the progress line
+ **********************************************************************************************************************/
+static void ProgressShow(ProgressType *progress, double now, bool final)
+{
+  uint64_t txBytes, rxBytes;
+  double elapsed = now - progress->startTime;
+  double payload = (double)(progress->count[ProgressRead] + progress->count[ProgressProgram]) *
+                   sizeof(AppClockMatrixBitmap);
+  double rate = (elapsed > 0) ? (progress->done / elapsed) : 0;
+  uint32_t eta = (rate > 0) ? ((progress->total - progress->done) / rate) : 0;
+  const char *device = progress->device;
+  bool inPlace = (device == NULL) && isatty(STDERR_FILENO);
+
+  ProgressGetWireBytes(progress, &txBytes, &rxBytes);
+  fprintf(stderr, "%s%s%s%s: %u/%u pages %3u%%, %.0f pages/s, payload %.0f B/s, wire %.0f B/s, "
+    "erase %.1f s, program %.1f s, read %.1f s, ETA %u:%02u%s",
+    inPlace ? "\r" : "", device ? device : "", device ? " " : "", progress->task, progress->done, progress->total,
+    progress->total ? (uint32_t)((100ULL * progress->done) / progress->total) : 100, rate,
+    (elapsed > 0) ? (payload / elapsed) : 0,
+    (elapsed > 0) ? ((txBytes - progress->txBytes + rxBytes - progress->rxBytes) / elapsed) : 0,
+    progress->seconds[ProgressErase], progress->seconds[ProgressProgram], progress->seconds[ProgressRead],
+    eta / 60, eta % 60, (final || !inPlace) ? "\n" : "");
+  progress->shownTime = now;
+}
+
+/***********************************************************************************************************************
+ * Account one device operation (page read, page program or sector erase) started at startTime
+ **********************************************************************************************************************/
+void ProgressAdd(ProgressType *progress, ProgressOperationType operation, double startTime)
+{
+  if(!progress->active) {
+    return;
+  }
+
+  progress->count[operation]++;
+  progress->seconds[operation] += ProgressGetTime() - startTime;
+}
+
+/***********************************************************************************************************************
+ * Mark pages of the task as done (transferred or skipped), show progress at a bounded rate
+ **********************************************************************************************************************/
+void ProgressAdvance(ProgressType *progress, uint32_t pages)
+{
+  double now;
+
+  if(!progress->active) {
+    return;
+  }
+
+  progress->done += pages;
+  if(show && (((now = ProgressGetTime()) - progress->shownTime) >= PROGRESS_INTERVAL)) {
+    ProgressShow(progress, now, false);
+  }
+}
+
+/***********************************************************************************************************************
+ * Write a string as JSON string, device paths may hold anything
+ **********************************************************************************************************************/
+static void ProgressWriteJsonString(FILE *file, const char *string)
+{
+  fputc('"', file);
+  for(; *string; string++) {
+    unsigned char c = *string;
+    if((c == '"') || (c == '\\')) {
+      fprintf(file, "\\%c", c);
+    }
+    else if(c < 0x20) {
+      fprintf(file, "\\u%04x", c);
+    }
+    else {
+      fputc(c, file);
+    }
+  }
+  fputc('"', file);
+}
+
+/***********************************************************************************************************************
+ * Finish the task: show the final progress line, append the summary and free the task
+ **********************************************************************************************************************/
+void ProgressFinish(ProgressType *progress)
+{
+  double now = ProgressGetTime();
+  const char *device = progress->device;
+  uint64_t txBytes, rxBytes;
+  FILE *file;
+
+  if(show && progress->active) {
+    ProgressShow(progress, now, true);
+  }
+
+  if(progress->active && (summaryFilename != NULL)) {
+    pthread_mutex_lock(&summaryLock);
+    if((file = fopen(summaryFilename, "a")) == NULL) {
+      ExitWithError("Unable to open summary file: %s", summaryFilename);
+    }
+    ProgressGetWireBytes(progress, &txBytes, &rxBytes);
+    fputc('{', file);
+    if(device != NULL) {
+      fprintf(file, "\"device\":");
+      ProgressWriteJsonString(file, device);
+      fputc(',', file);
+    }
+    fprintf(file, "\"task\":");
+    ProgressWriteJsonString(file, progress->task);
+    fprintf(file, ",\"pages\":%u,\"total_pages\":%u,\"seconds\":%.3f,\"payload_bytes\":%llu,"
+      "\"wire_tx_bytes\":%llu,\"wire_rx_bytes\":%llu,\"reads\":%u,\"read_seconds\":%.3f,\"erases\":%u,"
+      "\"erase_seconds\":%.3f,\"programs\":%u,\"program_seconds\":%.3f,\"retransmits\":%u}\n",
+      progress->done, progress->total, now - progress->startTime,
+      (unsigned long long)(progress->count[ProgressRead] + progress->count[ProgressProgram]) *
+        sizeof(AppClockMatrixBitmap),
+      (unsigned long long)(txBytes - progress->txBytes), (unsigned long long)(rxBytes - progress->rxBytes),
+      progress->count[ProgressRead], progress->seconds[ProgressRead],
+      progress->count[ProgressErase], progress->seconds[ProgressErase],
+      progress->count[ProgressProgram], progress->seconds[ProgressProgram],
+      ProgressGetRetransmits(progress) - progress->retransmits);
+    if(fclose(file) != 0) {
+      ExitWithError("Unable to write summary file: %s", summaryFilename);
+    }
+    pthread_mutex_unlock(&summaryLock);
+  }
+
+  free(progress);
+}
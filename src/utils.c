@@ -35,6 +35,7 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <errno.h>
+#include "utils.h"
 
 /***********************************************************************************************************************
  * Exit with error messages
@@ -55,6 +56,44 @@ void ExitWithError(char *fmt,...)
   exit(EXIT_FAILURE);
 }
 
+/***********************************************************************************************************************
+ * Open the connection to the device, exit if it is not possible
+ **********************************************************************************************************************/
+AppType *OpenDevice(char *device)
+{
+  AppType *app = AppInit(device);
+
+  if(app == NULL) {
+    ExitWithError("Could not open device: %s", device);
+  }
+
+  return app;
+}
+
+/***********************************************************************************************************************
+ * Close the connection to the device, exit if it is not released cleanly
+ **********************************************************************************************************************/
+void CloseDevice(AppType *app)
+{
+  if(AppCleanup(app) != AppOk) {
+    ExitWithError("Could not close device");
+  }
+}
+
+/***********************************************************************************************************************
+ * Exit with the error description of the connection if the command failed
+ **********************************************************************************************************************/
+void ExitOnAppError(AppType *app, AppStatusType status)
+{
+  if(status != AppOk) {
+    // System error details only make sense if the device itself failed
+    if(status != AppIoError) {
+      errno = 0;
+    }
+    ExitWithError("%s", AppGetError(app));
+  }
+}
+
 /***********************************************************************************************************************
  * Print a buffer content in HEX
  **********************************************************************************************************************/
@@ -34,8 +34,12 @@
 #define UTILS_H_
 
 #include <stdint.h>
+#include "app.h"
 
 void ExitWithError(char *fmt, ...);
+AppType *OpenDevice(char *device);
+void CloseDevice(AppType *app);
+void ExitOnAppError(AppType *app, AppStatusType status);
 void PrintBuffer(void *buffer, uint16_t len, const char *fmt, ...);
 
 #endif // UTILS_H_
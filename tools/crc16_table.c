@@ -0,0 +1,79 @@
+/***********************************************************************************************************************
+ *
+ * ID100 Utility
+ * CRC-16 Table Generator
+ *
+ * (C) 2017 Gergely Budai
+ *
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ *
+ **********************************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+
+// Must match the polynom in crc16.c
+#define CRC16_POLYNOM 0x8005
+// Number of slice tables (slice-by-8 needs 8)
+#define CRC16_SLICES  8
+
+/***********************************************************************************************************************
+ * Generate the CRC-16 lookup tables as C source on stdout
+ **********************************************************************************************************************/
+int main(void)
+{
+  static uint16_t table[CRC16_SLICES][256];
+  unsigned int slice, idx, bit;
+
+  // Table 0: effect of one byte on an empty CRC
+  for(idx = 0; idx < 256; idx++) {
+    uint16_t crc = idx << 8;
+    for(bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ CRC16_POLYNOM : crc << 1;
+    }
+    table[0][idx] = crc;
+  }
+
+  // Table n: effect of one byte followed by n zero bytes
+  for(slice = 1; slice < CRC16_SLICES; slice++) {
+    for(idx = 0; idx < 256; idx++) {
+      uint16_t crc = table[slice - 1][idx];
+      table[slice][idx] = (crc << 8) ^ table[0][crc >> 8];
+    }
+  }
+
+  printf("// Generated by tools/crc16_table.c, do not edit\n");
+  printf("static const Crc16Type crc16Table[%u][256] = {\n", CRC16_SLICES);
+  for(slice = 0; slice < CRC16_SLICES; slice++) {
+    printf("  {");
+    for(idx = 0; idx < 256; idx++) {
+      printf("%s0x%04X%s", (idx % 8) ? " " : "\n    ", table[slice][idx], (idx < 255) ? "," : "");
+    }
+    printf("\n  }%s\n", (slice < (CRC16_SLICES - 1)) ? "," : "");
+  }
+  printf("};\n");
+
+  return 0;
+}
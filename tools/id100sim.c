@@ -0,0 +1,576 @@
+/***********************************************************************************************************************
+ *
+ * ID100 Utility
+ * ID100 Device Simulator
+ *
+ * (C) 2017 Gergely Budai
+ *
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ *
+ **********************************************************************************************************************/
+// Pseudo terminal functions
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+#include "app.h"
+#include "link.h"
+#include "bitmap.h"
+
+// Timing of the real device: serial line speed, sector erase and page program time (us)
+#define SIM_DEFAULT_BAUD          38400
+#define SIM_DEFAULT_ERASE_TIME    45000
+#define SIM_DEFAULT_PROGRAM_TIME  700
+// Bits on the wire per byte (start, 8 data, stop)
+#define SIM_BITS_PER_BYTE         10
+
+// Firmware version reported
+#define SIM_VERSION_MAJOR    1
+#define SIM_VERSION_MINOR    0
+#define SIM_VERSION_REVISION 0
+
+// Size of one flash page
+#define SIM_FLASH_PAGE_SIZE  256
+
+// Biggest answer: flash page with its number
+#define SIM_MAX_ANSWER_LENGTH sizeof(AppFlashConfigPageType)
+
+// Settings
+static struct {
+  uint32_t baud;
+  uint32_t eraseTime;
+  uint32_t programTime;
+  // Every n-th answer is corrupted / dropped (0: never)
+  uint32_t corruptEvery;
+  uint32_t dropEvery;
+  // Print preview frames
+  bool verbose;
+} settings = {
+  .baud = SIM_DEFAULT_BAUD,
+  .eraseTime = SIM_DEFAULT_ERASE_TIME,
+  .programTime = SIM_DEFAULT_PROGRAM_TIME
+};
+
+// State of the simulated device
+static struct {
+  uint8_t flash[APP_CLOCK_CONFIG_FLASH_PAGES][SIM_FLASH_PAGE_SIZE];
+  // Device time is the system time plus this offset
+  time_t timeOffset;
+  AppDaylightSavingType daylightSaving;
+  bool preview;
+  AppMatrixBitmapType previewMatrix;
+  AppIntensityType intensity;
+  AppRtcCalibrationValueType ppmDifference;
+  AppRtcCalibrationDateTime lastCalibration;
+  AppStandbyType standby;
+  AppointmentsConfigType appointments;
+} device;
+
+// Statistics
+static struct {
+  uint32_t commands[256];
+  uint32_t answers;
+  uint32_t badFrames;
+  uint32_t badCommands;
+  uint32_t corrupted;
+  uint32_t dropped;
+} stats;
+
+static volatile sig_atomic_t quit = false;
+static volatile sig_atomic_t printStats = false;
+
+/***********************************************************************************************************************
+ * Signal handler, statistics on SIGUSR1, quit on anything else
+ **********************************************************************************************************************/
+static void SimSignal(int signal)
+{
+  if(signal == SIGUSR1) {
+    printStats = true;
+  }
+  else {
+    quit = true;
+  }
+}
+
+/***********************************************************************************************************************
+ * Print statistics to stderr
+ **********************************************************************************************************************/
+static void SimPrintStats(void)
+{
+  uint16_t command;
+
+  fprintf(stderr, "Commands:");
+  for(command = 0; command < 256; command++) {
+    if(stats.commands[command]) {
+      fprintf(stderr, " %c=%u", command, stats.commands[command]);
+    }
+  }
+  fprintf(stderr, ", answers %u, bad frames %u, bad commands %u, corrupted %u, dropped %u\n", stats.answers,
+    stats.badFrames, stats.badCommands, stats.corrupted, stats.dropped);
+}
+
+/***********************************************************************************************************************
+ * Wait the given number of microseconds
+ **********************************************************************************************************************/
+static void SimDelay(uint64_t us)
+{
+  struct timespec delay = { .tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000 };
+
+  while((nanosleep(&delay, &delay) != 0) && (errno == EINTR) && !quit);
+}
+
+/***********************************************************************************************************************
+ * Wait the time the given number of bytes need on the serial line
+ **********************************************************************************************************************/
+static void SimWireDelay(uint32_t bytes)
+{
+  if(settings.baud) {
+    SimDelay(((uint64_t)bytes * SIM_BITS_PER_BYTE * 1000000) / settings.baud);
+  }
+}
+
+/***********************************************************************************************************************
+ * Set the device to factory defaults, flash contents are kept
+ **********************************************************************************************************************/
+static void SimFactoryReset(void)
+{
+  device.timeOffset = 0;
+  device.daylightSaving = AppWinterTime;
+  device.preview = false;
+  device.intensity = AppIntensity5;
+  device.ppmDifference = 0;
+  memset(&device.lastCalibration, 0, sizeof(device.lastCalibration));
+  memset(&device.standby, 0, sizeof(device.standby));
+  memset(device.appointments, 0, sizeof(device.appointments));
+}
+
+/***********************************************************************************************************************
+ * Get the broken down device time
+ **********************************************************************************************************************/
+static void SimGetTime(struct tm *deviceTime)
+{
+  time_t now = time(NULL) + device.timeOffset;
+
+  gmtime_r(&now, deviceTime);
+}
+
+/***********************************************************************************************************************
+ * Send an answer frame, apply fault injection and line timing
+ **********************************************************************************************************************/
+static void SimSendAnswer(int port, uint8_t command, const void *buffer, uint16_t length)
+{
+  uint8_t frame[LINK_MAX_FRAME_LENGTH(SIM_MAX_ANSWER_LENGTH)];
+  uint16_t frameLength = LinkEncodeFrame(frame, command, buffer, length);
+
+  stats.answers++;
+  if(settings.dropEvery && ((stats.answers % settings.dropEvery) == 0)) {
+    stats.dropped++;
+    return;
+  }
+  if(settings.corruptEvery && ((stats.answers % settings.corruptEvery) == 0)) {
+    frame[frameLength - 1] ^= 0x40;
+    stats.corrupted++;
+  }
+
+  SimWireDelay(frameLength);
+  if(write(port, frame, frameLength) != frameLength) {
+    fprintf(stderr, "Could not send answer\n");
+  }
+}
+
+/***********************************************************************************************************************
+ * Get a big endian page number
+ **********************************************************************************************************************/
+static uint16_t SimGetPage(const uint8_t *buffer)
+{
+  return ((uint16_t)buffer[0] << 8) | buffer[1];
+}
+
+/***********************************************************************************************************************
+ * Execute a command, return false if it is unknown or has a bad length (no answer is sent then)
+ **********************************************************************************************************************/
+static bool SimExecute(int port, uint8_t command, uint8_t *data, uint16_t length)
+{
+  // Expected length of the data for every command
+  static const uint16_t commandLength[256] = {
+    ['v'] = 0, ['t'] = 0, ['T'] = sizeof(AppDateTimeType), ['A'] = 0, ['a'] = 0, ['X'] = 0, ['!'] = 0,
+    ['D'] = sizeof(AppMatrixBitmapType), ['b'] = 0, ['B'] = sizeof(AppIntensityType), ['c'] = 0,
+    ['C'] = sizeof(AppRtcCalibrationValueType), ['s'] = 0, ['S'] = sizeof(AppStandbyType), ['f'] = sizeof(uint16_t),
+    ['E'] = sizeof(uint16_t), ['F'] = sizeof(AppFlashClockConfigType), ['r'] = 0, ['R'] = sizeof(AppointmentsConfigType)
+  };
+  static const char commands[] = "vtTAaX!DbBcCsSfEFrR";
+  struct tm deviceTime;
+  uint16_t page;
+
+  if((command == 0) || (strchr(commands, command) == NULL) || (length != commandLength[command])) {
+    return false;
+  }
+  stats.commands[command]++;
+
+  switch(command) {
+    case 'v': {
+      uint8_t version[] = { 0, SIM_VERSION_MAJOR, 0, SIM_VERSION_MINOR, 0, SIM_VERSION_REVISION };
+      SimSendAnswer(port, command, version, sizeof(version));
+    }
+    break;
+
+    case 't': {
+      AppDateTimeType dateTime;
+      SimGetTime(&deviceTime);
+      dateTime.day = deviceTime.tm_mday;
+      dateTime.month = deviceTime.tm_mon + 1;
+      dateTime.year = deviceTime.tm_year - 100;
+      dateTime.weekDay = deviceTime.tm_wday;
+      dateTime.hour = deviceTime.tm_hour;
+      dateTime.minute = deviceTime.tm_min;
+      dateTime.second = deviceTime.tm_sec;
+      dateTime.daylightSaving = device.daylightSaving;
+      SimSendAnswer(port, command, &dateTime, sizeof(dateTime));
+    }
+    break;
+
+    case 'T': {
+      AppDateTimeType *dateTime = (AppDateTimeType *)data;
+      memset(&deviceTime, 0, sizeof(deviceTime));
+      deviceTime.tm_mday = dateTime->day;
+      deviceTime.tm_mon = dateTime->month - 1;
+      deviceTime.tm_year = dateTime->year + 100;
+      deviceTime.tm_hour = dateTime->hour;
+      deviceTime.tm_min = dateTime->minute;
+      deviceTime.tm_sec = dateTime->second;
+      device.timeOffset = timegm(&deviceTime) - time(NULL);
+      device.daylightSaving = dateTime->daylightSaving;
+      SimSendAnswer(port, command, NULL, 0);
+    }
+    break;
+
+    case 'A':
+    case 'a': {
+      device.preview = (command == 'a');
+      SimSendAnswer(port, command, NULL, 0);
+    }
+    break;
+
+    case 'X': {
+      SimFactoryReset();
+      SimSendAnswer(port, command, NULL, 0);
+    }
+    break;
+
+    case '!': {
+      fprintf(stderr, "Bootloader activated\n");
+      SimSendAnswer(port, command, NULL, 0);
+    }
+    break;
+
+    case 'D': {
+      memcpy(device.previewMatrix, data, sizeof(device.previewMatrix));
+      if(settings.verbose) {
+        BitmapPrint(stdout, device.previewMatrix, '#');
+        printf("\n");
+        fflush(stdout);
+      }
+      SimSendAnswer(port, command, NULL, 0);
+    }
+    break;
+
+    case 'b': {
+      SimSendAnswer(port, command, &device.intensity, sizeof(device.intensity));
+    }
+    break;
+
+    case 'B': {
+      device.intensity = data[0];
+      SimSendAnswer(port, command, NULL, 0);
+    }
+    break;
+
+    case 'c': {
+      AppLastCalibrationType lastCalibration;
+      SimGetTime(&deviceTime);
+      lastCalibration.actualDateTime.day = deviceTime.tm_mday;
+      lastCalibration.actualDateTime.month = deviceTime.tm_mon + 1;
+      lastCalibration.actualDateTime.year = deviceTime.tm_year - 100;
+      lastCalibration.actualDateTime.hour = deviceTime.tm_hour;
+      lastCalibration.actualDateTime.minute = deviceTime.tm_min;
+      lastCalibration.actualDateTime.second = deviceTime.tm_sec;
+      lastCalibration.actualDateTime.daylightSaving = device.daylightSaving;
+      lastCalibration.lastCalibrationDateTime = device.lastCalibration;
+      SimSendAnswer(port, command, &lastCalibration, sizeof(lastCalibration));
+    }
+    break;
+
+    case 'C': {
+      memcpy(&device.ppmDifference, data, sizeof(device.ppmDifference));
+      SimGetTime(&deviceTime);
+      device.lastCalibration.day = deviceTime.tm_mday;
+      device.lastCalibration.month = deviceTime.tm_mon + 1;
+      device.lastCalibration.year = deviceTime.tm_year - 100;
+      device.lastCalibration.hour = deviceTime.tm_hour;
+      device.lastCalibration.minute = deviceTime.tm_min;
+      device.lastCalibration.second = deviceTime.tm_sec;
+      device.lastCalibration.daylightSaving = device.daylightSaving;
+      SimSendAnswer(port, command, NULL, 0);
+    }
+    break;
+
+    case 's': {
+      SimSendAnswer(port, command, &device.standby, sizeof(device.standby));
+    }
+    break;
+
+    case 'S': {
+      memcpy(&device.standby, data, sizeof(device.standby));
+      SimSendAnswer(port, command, NULL, 0);
+    }
+    break;
+
+    case 'f': {
+      uint8_t answer[sizeof(AppFlashConfigPageType)];
+      if((page = SimGetPage(data)) >= APP_CLOCK_CONFIG_FLASH_PAGES) {
+        return false;
+      }
+      memcpy(answer, data, sizeof(uint16_t));
+      memcpy(&answer[sizeof(uint16_t)], device.flash[page], SIM_FLASH_PAGE_SIZE);
+      SimSendAnswer(port, command, answer, sizeof(answer));
+    }
+    break;
+
+    case 'E': {
+      if((page = SimGetPage(data)) >= APP_CLOCK_CONFIG_FLASH_PAGES) {
+        return false;
+      }
+      // The whole sector holding the page is erased
+      page -= page % APP_FLASH_PAGES_PER_SECTOR;
+      memset(device.flash[page], 0xFF, APP_FLASH_PAGES_PER_SECTOR * SIM_FLASH_PAGE_SIZE);
+      SimDelay(settings.eraseTime);
+      SimSendAnswer(port, command, data, sizeof(uint16_t));
+    }
+    break;
+
+    case 'F': {
+      uint16_t i;
+      if((page = SimGetPage(data)) >= APP_CLOCK_CONFIG_FLASH_PAGES) {
+        return false;
+      }
+      // Programming can only clear bits
+      for(i = 0; i < sizeof(AppClockMatrixBitmap); i++) {
+        device.flash[page][i] &= data[sizeof(uint16_t) + i];
+      }
+      SimDelay(settings.programTime);
+      SimSendAnswer(port, command, data, sizeof(uint16_t));
+    }
+    break;
+
+    case 'r': {
+      SimSendAnswer(port, command, device.appointments, sizeof(device.appointments));
+    }
+    break;
+
+    case 'R': {
+      memcpy(device.appointments, data, sizeof(device.appointments));
+      SimSendAnswer(port, command, NULL, 0);
+    }
+    break;
+  }
+
+  return true;
+}
+
+/***********************************************************************************************************************
+ * Open the pseudo terminal, the slave side is kept open so the master survives clients coming and going
+ **********************************************************************************************************************/
+static int SimOpenPty(int *slave)
+{
+  struct termios tty;
+  int port;
+
+  if(((port = posix_openpt(O_RDWR | O_NOCTTY)) < 0) || (grantpt(port) != 0) || (unlockpt(port) != 0)) {
+    perror("Could not open pseudo terminal");
+    exit(EXIT_FAILURE);
+  }
+  if((*slave = open(ptsname(port), O_RDWR | O_NOCTTY)) < 0) {
+    perror("Could not open pseudo terminal slave");
+    exit(EXIT_FAILURE);
+  }
+  if(tcgetattr(*slave, &tty) == 0) {
+    cfmakeraw(&tty);
+    tcsetattr(*slave, TCSANOW, &tty);
+  }
+
+  return port;
+}
+
+/***********************************************************************************************************************
+ * Print usage
+ **********************************************************************************************************************/
+static void SimUsage(void)
+{
+  fprintf(stderr,
+    "ID100 Device Simulator\n"
+    "Usage:\n"
+    " -b baud                 Serial line speed to model, 0 for no line delay (default %u)\n"
+    " -e us                   Sector erase time (default %u)\n"
+    " -p us                   Page program time (default %u)\n"
+    " -l link                 Create symbolic link to the pseudo terminal\n"
+    " -c n                    Corrupt every n-th answer\n"
+    " -d n                    Drop every n-th answer\n"
+    " -v                      Print preview frames on stdout\n"
+    "The pseudo terminal is printed on stdout, statistics on stderr on exit and on SIGUSR1.\n",
+    SIM_DEFAULT_BAUD, SIM_DEFAULT_ERASE_TIME, SIM_DEFAULT_PROGRAM_TIME);
+}
+
+/***********************************************************************************************************************
+ * Simulate an ID100 on a pseudo terminal
+ **********************************************************************************************************************/
+int main(int numberOfArguments, char *arguments[])
+{
+  static uint8_t data[LINK_MAX_BUFFER_LENGTH];
+  uint8_t rxBuffer[1024];
+  LinkDecoderType decoder;
+  char *linkName = NULL;
+  uint32_t frameBytes = 0;
+  int option, port, slave;
+
+  while((option = getopt(numberOfArguments, arguments, "b:e:p:l:c:d:v")) != -1) {
+    switch(option) {
+      case 'b' : {
+        settings.baud = atoi(optarg);
+      }
+      break;
+
+      case 'e' : {
+        settings.eraseTime = atoi(optarg);
+      }
+      break;
+
+      case 'p' : {
+        settings.programTime = atoi(optarg);
+      }
+      break;
+
+      case 'l' : {
+        linkName = optarg;
+      }
+      break;
+
+      case 'c' : {
+        settings.corruptEvery = atoi(optarg);
+      }
+      break;
+
+      case 'd' : {
+        settings.dropEvery = atoi(optarg);
+      }
+      break;
+
+      case 'v' : {
+        settings.verbose = true;
+      }
+      break;
+
+      // Bad arguments
+      default: {
+        SimUsage();
+        return EXIT_FAILURE;
+      }
+      break;
+    }
+  }
+
+  memset(device.flash, 0xFF, sizeof(device.flash));
+  SimFactoryReset();
+
+  port = SimOpenPty(&slave);
+  if(linkName != NULL) {
+    unlink(linkName);
+    if(symlink(ptsname(port), linkName) != 0) {
+      perror("Could not create link");
+      return EXIT_FAILURE;
+    }
+  }
+  printf("%s\n", ptsname(port));
+  fflush(stdout);
+
+  struct sigaction action = { .sa_handler = SimSignal };
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  sigaction(SIGUSR1, &action, NULL);
+
+  LinkDecoderInit(&decoder, data, sizeof(data));
+  while(!quit) {
+    ssize_t received = read(port, rxBuffer, sizeof(rxBuffer));
+    uint16_t offset = 0, consumed;
+
+    if(printStats) {
+      printStats = false;
+      SimPrintStats();
+    }
+    if(received <= 0) {
+      if((received < 0) && (errno != EINTR) && (errno != EIO)) {
+        perror("Could not receive");
+        break;
+      }
+      continue;
+    }
+
+    // Decode every frame in the received data
+    while(offset < received) {
+      LinkDecoderEventType event = LinkDecoderPush(&decoder, &rxBuffer[offset], received - offset, &consumed);
+      offset += consumed;
+      frameBytes += consumed;
+
+      if(event == LinkDecoderFrame) {
+        // Command had to get over the line first
+        SimWireDelay(frameBytes);
+        if(!SimExecute(port, decoder.command, data, decoder.length)) {
+          stats.badCommands++;
+        }
+        frameBytes = 0;
+      }
+      else if(event != LinkDecoderMore) {
+        stats.badFrames++;
+      }
+    }
+  }
+
+  SimPrintStats();
+  if(linkName != NULL) {
+    unlink(linkName);
+  }
+  close(slave);
+  close(port);
+
+  return EXIT_SUCCESS;
+}